@@ -40,7 +40,8 @@ public:
 
   enum node_type {
     nt_unset, nt_object, nt_array,
-    nt_bool, nt_int, nt_uint, nt_uint128, nt_string
+    nt_bool, nt_int, nt_uint, nt_uint128, nt_string,
+    nt_stream // Object or array rendered by stream_writer
   };
 
   // initializer_list<> elements.
@@ -101,6 +102,8 @@ private:
 
   typedef std::vector<node_info> node_path;
 
+  struct node;
+
 public:
   /// Reference to a JSON element.
   class ref
@@ -137,6 +140,13 @@ public:
     ref with_suffix(const char * key_suffix) const
       { return ref(*this, "", key_suffix); }
 
+    /// Return reference to a streamed element.  If streaming is enabled,
+    /// all elements below are rendered directly to JSON text in the order
+    /// they are written and no tree nodes are created.  Each element must
+    /// then be written once and in document order, other writes are dropped
+    /// (see json::get_stream_dropped()).
+    ref stream() const;
+
     void set_uint128(uint64_t value_hi, uint64_t value_lo);
 
     // Output only if safe integer.
@@ -165,10 +175,15 @@ public:
     ref(const ref & base, const char * /*dummy*/, const char * key_suffix);
 
     void operator=(const initlist_value & value)
-      { m_js.set_initlist_value(m_path, value); }
+      { m_js.set_initlist_value(*this, value); }
+
+    node * find_node() const;
 
     json & m_js;
+    node * m_base; //< Existing ancestor node, m_path is relative to it
     node_path m_path;
+    int m_stream_start = -1; //< Length of m_path to streamed element, -1 if none
+    mutable node * m_node = nullptr; //< Node of this element if already found
   };
 
   /// Return reference to element of top level object.
@@ -191,10 +206,33 @@ public:
   bool is_enabled() const
     { return m_enabled; }
 
+  /// Enable streaming of elements returned by ref::stream().
+  /// Output must then be printed as unsorted JSON with same PRETTY option.
+  void enable_streaming(bool pretty)
+    { m_streaming = true; m_stream_pretty = pretty; }
+
+  /// Return number of values below streamed elements which were dropped
+  /// because they were already written or changed the type of an element.
+  unsigned get_stream_dropped() const
+    { return m_stream_dropped; }
+
+  /// Return path of the first dropped value, e.g. ".a.b[1]".
+  const std::string & get_stream_dropped_path() const
+    { return m_stream_dropped_path; }
+
+  /// Remove all elements, options are kept.
+  /// All refs to elements become invalid.
+  void clear();
+
   /// Enable/disable extra string output for safe integers also.
   void set_verbose(bool yes = true)
     { m_verbose = yes; }
 
+  /// Enable/disable output of unsafe integers as numbers only, without the
+  /// extra "KEY_s" and "KEY_le" elements.  Useful for binary output.
+  void set_native_ints(bool yes = true)
+    { m_native_ints = yes; }
+
   /// Return true if any 128-bit value has been output.
   bool has_uint128_output() const
     { return m_uint128_output; }
@@ -203,13 +241,27 @@ public:
   struct print_options {
     bool pretty = false; //< Pretty-print output.
     bool sorted = false; //< Sort object keys.
-    char format = 0; //< 'y': YAML, 'g': flat(grep, gron), other: JSON
+    char format = 0; //< 'y': YAML, 'g': flat(grep, gron), 'b': CBOR, other: JSON
   };
 
   /// Print JSON tree to a file.
   void print(FILE * f, const print_options & options) const;
 
 private:
+  class stream_writer;
+  class out_buffer;
+
+  // Contiguous storage of array elements which are all scalars.
+  struct scalar_array
+  {
+    struct element {
+      node_type type = nt_unset; //< nt_unset: unset element of sparse array
+      uint64_t intval = 0, intval_hi = 0; //< nt_string: offset and length in strings
+    };
+    std::vector<element> elements;
+    std::string strings;
+  };
+
   struct node
   {
     node();
@@ -219,6 +271,7 @@ private:
     void operator=(const node &) = delete;
 
     node_type type = nt_unset;
+    int depth = 0; //< Level below root node
 
     uint64_t intval = 0, intval_hi = 0;
     std::string strval;
@@ -227,6 +280,15 @@ private:
     std::vector< std::unique_ptr<node> > childs;
     typedef std::map<std::string, unsigned> keymap;
     keymap key2index;
+    std::unique_ptr<stream_writer> stream;
+    std::unique_ptr<scalar_array> scalars; //< Used instead of childs if set
+
+    /// Return true if object or array has no elements.
+    bool empty() const
+      { return (scalars ? scalars->elements.empty() : childs.empty()); }
+
+    /// Move elements from scalars to childs.
+    void scalars_to_childs();
 
     class const_iterator
     {
@@ -242,30 +304,44 @@ private:
       bool m_use_map;
       unsigned m_child_idx = 0;
       keymap::const_iterator m_key_iter;
+      mutable std::unique_ptr<node> m_scalar_node; //< Current element of scalars
     };
   };
 
   bool m_enabled = false;
   bool m_verbose = false;
+  bool m_native_ints = false;
   bool m_uint128_output = false;
+  bool m_streaming = false;
+  bool m_stream_pretty = false;
+  unsigned m_stream_dropped = 0;
+  std::string m_stream_dropped_path;
 
   node m_root_node;
 
-  node * find_or_create_node(const node_path & path, node_type type);
-
-  void set_bool(const node_path & path, bool value);
-  void set_int64(const node_path & path, int64_t value);
-  void set_uint64(const node_path & path, uint64_t value);
-  void set_uint128(const node_path & path, uint64_t value_hi, uint64_t value_lo);
-  void set_cstring(const node_path & path, const char * value);
-  void set_string(const node_path & path, const std::string & value);
-  void set_initlist_value(const node_path & path, const initlist_value & value);
-
-  static void print_json(FILE * f, bool pretty, bool sorted, const node * p, int level);
-  static void print_yaml(FILE * f, bool pretty, bool sorted, const node * p, int level_o,
+  static node * find_path(node * base, const node_path & path);
+  static node * find_or_create_path(node * base, const node_path & path, unsigned len);
+  static node * find_or_create_node(const ref & r, node_type type);
+
+  bool set_streamed(const ref & r, node_type type, uint64_t intval,
+                    uint64_t intval_hi = 0, const char * strval = nullptr);
+  void set_value(const ref & r, node_type type, uint64_t intval,
+                 uint64_t intval_hi = 0, const char * strval = nullptr);
+
+  void set_bool(const ref & r, bool value);
+  void set_int64(const ref & r, int64_t value);
+  void set_uint64(const ref & r, uint64_t value);
+  void set_uint128(const ref & r, uint64_t value_hi, uint64_t value_lo);
+  void set_cstring(const ref & r, const char * value);
+  void set_string(const ref & r, const std::string & value);
+  void set_initlist_value(const ref & r, const initlist_value & value);
+
+  static void print_json(out_buffer & out, bool pretty, bool sorted, const node * p, int level);
+  static void print_yaml(out_buffer & out, bool pretty, bool sorted, const node * p, int level_o,
                          int level_a, bool cont);
-  static void print_flat(FILE * f, const char * assign, bool sorted, const node * p,
+  static void print_flat(out_buffer & out, const char * assign, bool sorted, const node * p,
                          std::string & path);
+  static void print_cbor(out_buffer & out, bool sorted, const node * p);
 };
 
 } // namespace smartmon
@@ -63,8 +63,13 @@ const char * get_drivedb_path_default();
 #endif
 
 // Read drive database from file.
+// Uses the binary file PATH.bin instead if created by
+// compile_drive_database() and PATH is unchanged since then.
 bool read_drive_database(const char * path);
 
+// Read drive database from text file PATH and write binary file PATH.bin.
+bool compile_drive_database(const char * path);
+
 // Init default db entry and optionally read drive databases from standard places.
 bool init_drive_database(bool use_default_db);
 
@@ -9,7 +9,10 @@
 #ifndef OCPTELEMETRY_H
 #define OCPTELEMETRY_H
 
-#include <map>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <smartmon/atacmds.h>
 #include <smartmon/dev_interface.h>
@@ -55,6 +58,7 @@ SMARTMON_ASSERT_SIZEOF(ata_device_internal_status, 512);
 // Section 7.2.10 in OCP Datacenter SAS-SATA Device Specification v1.5
 
 #define OCP_GUID_LEN 16
+#define OCP_FIRMWARE_VERSION_LEN 8
 #pragma pack(1)
 struct ocp_telemetry_data_header {
   uint16_t major_version;
@@ -64,7 +68,7 @@ struct ocp_telemetry_data_header {
   uint16_t timestamp_info;
   uint8_t  guid[OCP_GUID_LEN];       // F5DAF2C03433422EB616D11C79F6F9E3h
   uint16_t device_string_data_size;
-  uint8_t  firmware_version[8];
+  uint8_t  firmware_version[OCP_FIRMWARE_VERSION_LEN];
   uint8_t  bytes042_109[68];
   uint64_t statistic1_start_dword;   // dword
   uint64_t statistic1_size_dword;
@@ -272,10 +276,11 @@ struct ocp_hdd_spinup_stat_desc {
 
 struct ocp_stat_str_def {
   uint16_t id;
-  char desc[128];
+  const char * desc;
 };
 
-static const struct ocp_stat_str_def ocp_builtin_stat_str[] = {
+// Sorted by id, see ocp_builtin_stat_id_to_str().
+static constexpr struct ocp_stat_str_def ocp_builtin_stat_str[] = {
   {0x0002, "ATA Log"},
   {0x0003, "SCSI Log Page"},
 
@@ -361,6 +366,14 @@ static const struct ocp_stat_str_def ocp_builtin_stat_str[] = {
 
 #define OCP_BUILTIN_STAT_STR_LEN  (sizeof ocp_builtin_stat_str / sizeof ocp_builtin_stat_str[0])
 
+constexpr bool ocp_stat_str_is_sorted(const struct ocp_stat_str_def * table, size_t len)
+{
+  return (len < 2 || (table[0].id < table[1].id && ocp_stat_str_is_sorted(table + 1, len - 1)));
+}
+
+static_assert(ocp_stat_str_is_sorted(ocp_builtin_stat_str, OCP_BUILTIN_STAT_STR_LEN),
+              "ocp_builtin_stat_str[] must be sorted by id");
+
 enum ocp_event_class {
   OCP_EVENT_CLASS_TIMESTAMP       = 0x01,
   OCP_EVENT_CLASS_RESET           = 0x04,
@@ -700,23 +713,704 @@ struct ocp_event_class_0Dh {
 #pragma pack()
 SMARTMON_ASSERT_SIZEOF(ocp_event_class_0Dh, 28);
 
+// Vendor string table entry, refers to a string in the ASCII table.
+struct ocp_string_entry {
+  uint32_t key;    // Statistic id or OCP_EVENT_KEY()
+  uint32_t len;
+  uint64_t offset; // Offset into the ASCII table
+};
+
+// String without terminating null, points into the ASCII table.
+struct ocp_string_ref {
+  const char * str = nullptr;
+  size_t len = 0;
+};
+
 typedef struct ocp_string_def {
-  std::map<uint16_t, struct ocp_statistic_id_string_table_entry> stat_id_string_map;
-  std::map<uint32_t, struct ocp_event_id_string_table_entry> event_string_map;
-  char *ocp_string_ascii_table;
-  char event_fifo_1_name[OCP_FIFO_NAME_LEN + 1];
-  char event_fifo_2_name[OCP_FIFO_NAME_LEN + 1];
+  std::vector<uint8_t> string_area; // Log pages starting with the strings header
+  std::vector<ocp_string_entry> stat_id_strings; // Sorted by key
+  std::vector<ocp_string_entry> event_strings;   // Sorted by key
+  size_t ascii_table_offset = 0; // Offset into string_area
+  size_t ascii_table_size = 0;
+  char event_fifo_1_name[OCP_FIFO_NAME_LEN + 1] = ""; // Without trailing spaces
+  char event_fifo_2_name[OCP_FIFO_NAME_LEN + 1] = "";
 } ocp_string_def;
 
-bool read_ata_ocp_telemetry_string_state(ata_device * device, unsigned nsectors,
+// Source of OCP telemetry log pages.
+class ocp_log_reader
+{
+public:
+  virtual ~ocp_log_reader() { }
+
+  // Read NSECTORS log pages starting at PAGE.
+  virtual bool read_pages(unsigned char logaddr, unsigned page, void * data,
+                          unsigned nsectors) = 0;
+
+  // Read SIZE_DWORD dwords starting at dword START_DWORD of the data which
+  // begins at log page FIRST_PAGE.
+  bool read_dwords(unsigned char logaddr, unsigned first_page,
+                   uint64_t start_dword, uint64_t size_dword, void * data);
+};
+
+// Maximum number of log pages transferred by a single READ LOG EXT command.
+#define OCP_MAX_XFER_SECTORS 128
+
+// Reads OCP telemetry log pages from an ATA device.
+// Consecutive pages are transferred with multi-sector READ LOG EXT commands.
+// If such a command fails, the transfer size is halved and the read is retried.
+// The reduced size is kept for all further reads, so the limit of the device
+// and its transport is only probed once.
+class ocp_ata_log_reader
+: public ocp_log_reader
+{
+public:
+  explicit ocp_ata_log_reader(ata_device * device,
+                              unsigned max_sectors = OCP_MAX_XFER_SECTORS)
+    : m_device(device), m_max_sectors(max_sectors ? max_sectors : 1) { }
+
+  ata_device * get_device() const
+    { return m_device; }
+
+  // Current transfer size limit, may be used to init a later reader.
+  unsigned get_max_sectors() const
+    { return m_max_sectors; }
+
+  virtual bool read_pages(unsigned char logaddr, unsigned page, void * data,
+                          unsigned nsectors) override;
+
+private:
+  ata_device * m_device;
+  unsigned m_max_sectors;
+};
+
+// Error history buffer formats, SPC-5 section 6.20.2
+#define OCP_SCSI_BUFFER_FORMAT_CURRENT 0x01 // Current internal status parameter data
+#define OCP_SCSI_BUFFER_FORMAT_SAVED   0x02 // Saved internal status parameter data
+
+// Reads OCP telemetry from a SCSI device.  The current and saved internal
+// status parameter data are read from the error history buffers with
+// READ BUFFER mode 1Ch.  They are addressed like GP logs 0x24 and 0x25 in
+// 512 byte pages, so the same parser is used as for ATA devices.
+// The big endian fields of the internal status page (page 0) are converted
+// to the little endian ATA layout.
+// Reading the directory creates an error history snapshot if none exists.
+// The snapshot is released when the reader is destroyed, so the next
+// reader gets current data.
+class ocp_scsi_log_reader
+: public ocp_log_reader
+{
+public:
+  explicit ocp_scsi_log_reader(scsi_device * device,
+                               unsigned max_sectors = OCP_MAX_XFER_SECTORS)
+    : m_device(device), m_max_sectors(max_sectors ? max_sectors : 1) { }
+
+  virtual ~ocp_scsi_log_reader() override;
+
+  ocp_scsi_log_reader(const ocp_scsi_log_reader &) = delete;
+  void operator=(const ocp_scsi_log_reader &) = delete;
+
+  scsi_device * get_device() const
+    { return m_device; }
+
+  // Read the error history directory.  Return false if it could not be
+  // read or if no internal status buffer is reported.
+  bool read_directory();
+
+  // Release the error history snapshot, if any.  Also called by the
+  // destructor, which keeps the device error.  Further reads require
+  // read_directory().
+  bool release_snapshot();
+
+  // Number of pages of log 0x24 or 0x25, 0 if not supported.
+  unsigned get_num_sectors(unsigned char logaddr) const;
+
+  virtual bool read_pages(unsigned char logaddr, unsigned page, void * data,
+                          unsigned nsectors) override;
+
+private:
+  scsi_device * m_device;
+  unsigned m_max_sectors;
+  struct buffer_info {
+    int buffer_id = -1;
+    unsigned num_sectors = 0;
+  };
+  buffer_info m_current, m_saved; // Log 0x24, 0x25
+  bool m_snapshot = false; // Set if directory was read
+
+  const buffer_info * find_buffer(unsigned char logaddr) const;
+};
+
+// Capture of the OCP telemetry log pages read from a device.
+// If a source reader is specified, all pages read are passed through and
+// recorded.  Otherwise pages are returned from the capture, which is
+// usually loaded from a file.
+//
+// Capture file format (all values little endian):
+//   char     magic[8]        "OCPTLCAP"
+//   uint32_t version         OCP_CAPTURE_VERSION
+//   uint32_t num_logs
+//   num_logs times:
+//     uint8_t  logaddr
+//     uint8_t  source        0: ATA GP log, 1: SCSI error history buffer
+//     uint8_t  reserved[2]
+//     uint32_t num_sectors   Log size from the GP log directory
+//     uint32_t num_runs
+//     num_runs times:
+//       uint32_t first_page
+//       uint32_t num_pages
+//       uint8_t  data[num_pages * 512]
+#define OCP_CAPTURE_VERSION 1
+
+class ocp_capture_log_reader
+: public ocp_log_reader
+{
+public:
+  explicit ocp_capture_log_reader(ocp_log_reader * source = nullptr)
+    : m_source(source) { }
+
+  // Log size as reported by the GP log directory, 0 if unknown.
+  void set_num_sectors(unsigned char logaddr, unsigned nsectors)
+    { get_log(logaddr).num_sectors = nsectors; }
+  unsigned get_num_sectors(unsigned char logaddr) const;
+
+  // Pages were read from a SCSI device.
+  void set_scsi(bool scsi)
+    { m_scsi = scsi; }
+  bool is_scsi() const
+    { return m_scsi; }
+
+  virtual bool read_pages(unsigned char logaddr, unsigned page, void * data,
+                          unsigned nsectors) override;
+
+  // Write capture to file or read it from file.  Return false and set
+  // ERRMSG on error.
+  bool save(const char * filename, std::string & errmsg) const;
+  bool load(const char * filename, std::string & errmsg);
+
+private:
+  struct captured_log {
+    unsigned char logaddr = 0;
+    unsigned num_sectors = 0;
+    std::vector<uint8_t> data;  // Pages 0 to N-1
+    std::vector<bool> present;  // Page I was captured
+  };
+
+  ocp_log_reader * m_source;
+  bool m_scsi = false;
+  std::vector<captured_log> m_logs;
+
+  captured_log & get_log(unsigned char logaddr);
+  const captured_log * find_log(unsigned char logaddr) const;
+};
+
+// Bounds checked view of an OCP statistic descriptor in a raw buffer.
+// Nothing is copied, the view is only valid as long as the buffer.
+class ocp_stat_desc_view
+{
+public:
+  ocp_stat_desc_view() = default;
+
+  // DESC must point to a complete descriptor of SIZE bytes.
+  ocp_stat_desc_view(const uint8_t * desc, size_t size)
+    : m_desc(desc), m_size(size) { }
+
+  // Return size of descriptor at DESC in bytes, 0 at end of list.
+  // Return a value > AVAIL if the descriptor is truncated.
+  static size_t desc_size(const uint8_t * desc, size_t avail);
+
+  bool valid() const
+    { return !!m_desc; }
+
+  const ocp_statistic_descriptor * raw() const
+    { return (const ocp_statistic_descriptor *)m_desc; }
+
+  uint16_t id() const;
+  uint8_t stat_type() const
+    { return m_desc[2] >> 4; }
+  uint8_t behavior_type() const
+    { return m_desc[2] & 0xf; }
+  uint8_t unit() const
+    { return m_desc[3]; }
+  uint8_t host_hint_type() const
+    { return (m_desc[4] >> 4) & 0x3; }
+  uint8_t data_type() const
+    { return m_desc[4] & 0xf; }
+
+  // Statistic data following the header.
+  const uint8_t * data() const
+    { return m_desc + sizeof(ocp_statistic_header); }
+  size_t data_size() const
+    { return m_size - sizeof(ocp_statistic_header); }
+
+  // Value of a single statistic with 1, 2, 4 or 8 bytes.
+  bool get_uint(uint64_t * val) const;
+  bool get_int(int64_t * val) const;
+
+  // Elements of an array statistic, only those which fit into the
+  // descriptor are reported.
+  unsigned num_elements() const;
+  size_t element_size() const;
+  const uint8_t * element(unsigned i) const
+    { return data() + 4 + i * element_size(); }
+  bool get_element_uint(unsigned i, uint64_t * val) const;
+  bool get_element_int(unsigned i, int64_t * val) const;
+
+  // Custom statistics defined by the specification, nullptr if the
+  // descriptor has a different id or is too short.
+  const ocp_ata_log_stat_desc * ata_log() const;
+  const ocp_scsi_log_stat_desc * scsi_log() const;
+  const ocp_hdd_spinup_stat_desc * hdd_spinup() const;
+
+private:
+  const uint8_t * m_desc = nullptr;
+  size_t m_size = 0;
+};
+
+// Bounds checked view of an OCP event descriptor in a raw buffer.
+class ocp_event_desc_view
+{
+public:
+  ocp_event_desc_view() = default;
+
+  // DESC must point to a complete descriptor of SIZE bytes.
+  ocp_event_desc_view(const uint8_t * desc, size_t size)
+    : m_desc(desc), m_size(size) { }
+
+  // Return size of descriptor at DESC in bytes, 0 at end of FIFO.
+  // Return a value > AVAIL if the descriptor is truncated.
+  static size_t desc_size(const uint8_t * desc, size_t avail);
+
+  bool valid() const
+    { return !!m_desc; }
+
+  const ocp_event_descriptor * raw() const
+    { return (const ocp_event_descriptor *)m_desc; }
+
+  uint8_t class_type() const
+    { return m_desc[0]; }
+  const uint8_t * id_bytes() const
+    { return m_desc + 1; }
+  uint16_t id() const
+    { return m_desc[1] | m_desc[2] << 8; }
+
+  // Event data following the header.
+  const uint8_t * data() const
+    { return m_desc + sizeof(ocp_event_descriptor); }
+  size_t data_size() const
+    { return m_size - sizeof(ocp_event_descriptor); }
+
+  // Class specific data, nullptr or invalid view if the event has a
+  // different class or is too short.
+  bool get_timestamp(uint64_t * timestamp) const;
+  const ocp_event_media_wear * media_wear() const;
+  ocp_stat_desc_view stat_snapshot() const;
+  const ocp_event_virtual_fifo * virtual_fifo() const;
+  const ocp_event_class_0Dh * sata_transport() const;
+
+  // Size of the class specific data part of data().
+  size_t class_data_size() const;
+
+  // Vendor unique event following the class specific data, nullptr if none.
+  const ocp_event_vu * vu_event(size_t * vu_data_size) const;
+
+private:
+  const uint8_t * m_desc = nullptr;
+  size_t m_size = 0;
+};
+
+// Forward iterator over descriptors of type VIEW in a raw buffer.
+// Iteration stops at the end of the buffer, at an end marker or at a
+// descriptor which does not fit into the buffer.  The latter is reported
+// by truncated().
+template <class VIEW>
+class ocp_desc_iterator
+{
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef VIEW value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const VIEW * pointer;
+  typedef const VIEW & reference;
+
+  ocp_desc_iterator() = default;
+
+  ocp_desc_iterator(const uint8_t * pos, const uint8_t * end)
+    : m_pos(pos), m_end(end)
+    { load(); }
+
+  reference operator*() const
+    { return m_view; }
+  pointer operator->() const
+    { return &m_view; }
+
+  ocp_desc_iterator & operator++()
+    { m_pos += m_size; load(); return *this; }
+  ocp_desc_iterator operator++(int)
+    { ocp_desc_iterator it = *this; ++*this; return it; }
+
+  bool operator==(const ocp_desc_iterator & it) const
+    { return m_pos == it.m_pos; }
+  bool operator!=(const ocp_desc_iterator & it) const
+    { return m_pos != it.m_pos; }
+
+  // Offset of the current descriptor in the buffer.
+  const uint8_t * pos() const
+    { return m_pos; }
+
+  // True if iteration stopped at a truncated descriptor.
+  bool truncated() const
+    { return m_truncated; }
+
+private:
+  const uint8_t * m_pos = nullptr;
+  const uint8_t * m_end = nullptr;
+  size_t m_size = 0;
+  bool m_truncated = false;
+  VIEW m_view;
+
+  void load()
+    {
+      size_t avail = m_end - m_pos;
+      m_size = (avail ? VIEW::desc_size(m_pos, avail) : 0);
+      if (!m_size || m_size > avail) {
+        m_truncated = (m_size > avail);
+        m_pos = m_end; m_size = 0; m_view = VIEW();
+      }
+      else
+        m_view = VIEW(m_pos, m_size);
+    }
+};
+
+// Range of descriptors in a raw buffer of DWORDS dwords.
+template <class VIEW>
+class ocp_desc_range
+{
+public:
+  typedef ocp_desc_iterator<VIEW> iterator;
+
+  ocp_desc_range(const void * data, size_t dwords)
+    : m_begin((const uint8_t *)data), m_end(m_begin + (dwords << 2)) { }
+
+  iterator begin() const
+    { return iterator(m_begin, m_end); }
+  iterator end() const
+    { return iterator(m_end, m_end); }
+
+private:
+  const uint8_t * m_begin, * m_end;
+};
+
+typedef ocp_desc_range<ocp_stat_desc_view> ocp_stat_desc_range;
+typedef ocp_desc_range<ocp_event_desc_view> ocp_event_desc_range;
+
+// Return name of a statistic defined by the OCP specification, nullptr if unknown.
+const char * ocp_builtin_stat_id_to_str(uint16_t id);
+
+// Look up a vendor statistic or event name.  The string remains valid as
+// long as STRING_DEF is not modified.
+bool ocp_find_stat_id_string(const ocp_string_def * string_def, uint16_t id,
+                             ocp_string_ref * ref);
+bool ocp_find_event_string(const ocp_string_def * string_def, uint8_t dbg_class,
+                           const uint8_t id[2], ocp_string_ref * ref);
+
+// Persistent cache of OCP string tables.  The tables only change with the
+// firmware, so they are read from the device only once.  A cache file is
+// selected by the strings header GUID, the firmware version from the data
+// header and a hash of the strings header page.
+//
+// Cache file format (all values little endian, 8 byte aligned):
+//   char     magic[8]        "OCPSTRC1"
+//   uint32_t version         OCP_STRING_CACHE_VERSION
+//   uint32_t reserved
+//   uint8_t  firmware_version[8]
+//   uint64_t content_hash    FNV-1a of the string area
+//   uint32_t num_stat_strings
+//   uint32_t num_event_strings
+//   uint64_t string_area_size
+//   uint64_t ascii_table_offset
+//   uint64_t ascii_table_size
+//   uint8_t  header_page[512]
+//   ocp_string_entry stat_strings[num_stat_strings]   (16 bytes each)
+//   ocp_string_entry event_strings[num_event_strings]
+//   uint8_t  string_area[string_area_size]
+#define OCP_STRING_CACHE_VERSION 1
+
+class ocp_string_cache
+{
+public:
+  ocp_string_cache(const char * dir, const uint8_t firmware_version[OCP_FIRMWARE_VERSION_LEN]);
+
+  // Fill STRING_DEF from the cache file matching HEADER_PAGE, which is
+  // log page 1 with the strings header.  Return false if not cached.
+  bool load(const uint8_t * header_page, ocp_string_def * string_def);
+
+  // True if the last load() succeeded.
+  bool is_loaded() const
+    { return m_loaded; }
+
+  // Write the tables of STRING_DEF to the cache.  Return false and set
+  // ERRMSG on error.
+  bool save(const ocp_string_def * string_def, std::string & errmsg) const;
+
+private:
+  std::string m_dir;
+  uint8_t m_firmware_version[OCP_FIRMWARE_VERSION_LEN];
+  bool m_loaded = false;
+
+  std::string get_filename(const uint8_t * header_page) const;
+};
+
+// Position of the newest event already read from an OCP event FIFO.
+// The position is identified by a hash of the dwords preceding it, so it
+// is found again if the device dropped older events from the FIFO.
+struct ocp_event_cursor {
+  uint64_t end_dword = 0;      // End of newest event, relative to FIFO start
+  uint32_t tail_dwords = 0;    // Number of dwords before end_dword in tail_hash
+  uint64_t tail_hash = 0;      // FNV-1a of these dwords
+  uint64_t last_timestamp = 0; // Newest timestamp event, 0 if none seen
+
+  bool valid() const
+    { return tail_dwords > 0; }
+};
+
+// Maximum number of dwords used as fingerprint of a cursor position.
+#define OCP_EVENT_CURSOR_TAIL_DWORDS 32
+
+// Read the cursors of event FIFO 1 and 2 from a text file with lines
+// "ocp-event-fifo.N.NAME = VALUE".  If the file does not exist, the
+// cursors are reset.  Return false and set ERRMSG on error.
+bool ocp_load_event_cursors(const char * filename, ocp_event_cursor cursors[2],
+                            std::string & errmsg);
+
+// Write the cursors of event FIFO 1 and 2.
+bool ocp_save_event_cursors(const char * filename, const ocp_event_cursor cursors[2],
+                            std::string & errmsg);
+
+bool read_ata_ocp_telemetry_string_state(ocp_log_reader & reader, unsigned nsectors,
                                          struct ata_device_internal_status *internal_status,
                                          struct ocp_telemetry_strings_header *ocp_strings_header,
-                                         ocp_string_def *string_def);
+                                         ocp_string_def *string_def,
+                                         ocp_string_cache *cache = nullptr);
+
+// Read and check the data header only.
+bool read_ata_ocp_telemetry_data_header(ocp_log_reader & reader, unsigned nsectors,
+                                        struct ata_device_internal_status *internal_status,
+                                        struct ocp_telemetry_data_header *ocp_data_header);
+
+// Default block size of ocp_arena.
+#define OCP_ARENA_BLOCK_SIZE (64 * 1024)
+
+// Bump allocator.  Memory is handed out from large blocks and only released
+// as a whole.  reset() keeps the blocks for reuse, so decoding many captures
+// in one process does not churn the heap.
+class ocp_arena
+{
+public:
+  explicit ocp_arena(size_t block_size = OCP_ARENA_BLOCK_SIZE)
+    : m_block_size(block_size) { }
+
+  ~ocp_arena();
+
+  // Return SIZE bytes aligned to 8 bytes.  Throws std::bad_alloc.
+  void * alloc(size_t size);
+
+  // Release all allocations, keep the blocks.
+  void reset()
+    { m_cur = m_pos = m_used = 0; }
+
+  // Number of bytes allocated since the last reset().
+  size_t used() const
+    { return m_used; }
+
+private:
+  struct block {
+    uint8_t * data;
+    size_t size;
+  };
+  std::vector<block> m_blocks;
+  size_t m_block_size;
+  size_t m_cur = 0, m_pos = 0; // Current block and offset
+  size_t m_used = 0;
+
+  ocp_arena(const ocp_arena &) = delete;
+  void operator=(const ocp_arena &) = delete;
+};
+
+// State of one parse of OCP telemetry from a device or capture.
+// The session owns all data: the statistic areas and event FIFOs are
+// read into its arena, which may also be used for decoded values.
+// Everything is released together by the destructor or by reset(),
+// which keeps the arena blocks for the next capture.
+class ocp_telemetry_session
+{
+public:
+  ocp_telemetry_session() = default;
+
+  void reset();
+
+  ocp_arena & arena()
+    { return m_arena; }
+
+  // Read internal status and string tables from log 0x25.
+  // If CACHE is specified, the string tables are read from it if possible.
+  bool read_strings(ocp_log_reader & reader, unsigned nsectors,
+                    ocp_string_cache * cache = nullptr);
+
+  // Read internal status and data header from log 0x24.
+  bool read_data_header(ocp_log_reader & reader, unsigned nsectors);
+
+  // Read the data header, the statistic areas and the event FIFOs.
+  bool read_data(ocp_log_reader & reader, unsigned nsectors);
+
+  // Read the data header and the statistic areas only.
+  bool read_statistics(ocp_log_reader & reader, unsigned nsectors);
+
+  // Area of log 0x24, DATA is nullptr if empty or not read.
+  struct area {
+    const uint8_t * data = nullptr;
+    size_t dwords = 0;
+  };
+
+  // Results of read_strings()
+  ata_device_internal_status strings_status{};
+  ocp_telemetry_strings_header strings_header{};
+  ocp_string_def string_def;
+
+  // Results of read_data_header() and read_data()
+  ata_device_internal_status data_status{};
+  ocp_telemetry_data_header data_header{};
+  area statistic_areas[2];
+  area event_fifos[2];
+
+private:
+  ocp_arena m_arena;
+
+  bool read_areas(ocp_log_reader & reader, unsigned nsectors, int num_areas);
+
+  ocp_telemetry_session(const ocp_telemetry_session &) = delete;
+  void operator=(const ocp_telemetry_session &) = delete;
+};
+
+// Read the events of event FIFO FIFO_NUM (1 or 2) which follow the position
+// of CURSOR into EVENTS and advance CURSOR.  Only the log pages which may
+// contain new events are read: the FIFO is first read forward from the old
+// position.  If the fingerprint does not match there, older events were
+// dropped and the FIFO is searched backwards from its end.  If the position
+// is not found at all, all events are returned and *LOST is set.
+bool read_ata_ocp_telemetry_new_events(ocp_log_reader & reader,
+                                       const struct ocp_telemetry_data_header *ocp_data_header,
+                                       int fifo_num, ocp_event_cursor * cursor,
+                                       std::vector<uint8_t> & events, bool * lost);
+
+// Event of an ocp_event_timeline.
+struct ocp_timeline_event {
+  ocp_event_desc_view desc; // Points into the FIFO data
+  uint64_t time = 0;        // Milliseconds, from the preceding timestamp event
+  bool time_valid = false;  // False if no timestamp event precedes the event
+  uint8_t fifo = 0;         // Event FIFO number 1 or 2
+  unsigned index = 0;       // Index of the event in its FIFO
+};
+
+// Events of both event FIFOs merged into one time ordered sequence.
+// The time of each event is taken from the last preceding timestamp
+// event of the same FIFO.  Events with equal time keep their FIFO order,
+// events of FIFO 1 come first.  Events without time are placed before
+// all others.  An index by event class allows fast filtered queries.
+class ocp_event_timeline
+{
+public:
+  typedef std::vector<ocp_timeline_event>::const_iterator const_iterator;
+
+  // Add the events of FIFO_NUM (1 or 2).  DATA must remain valid as long
+  // as the timeline is used.  If START_TIME is specified, it is used for
+  // events preceding the first timestamp event.
+  // Return false if the FIFO ends with a truncated descriptor.
+  bool add_fifo(int fifo_num, const void * data, size_t dwords,
+                const uint64_t * start_time = nullptr);
+
+  void clear();
+
+  // All events in time order.
+  const std::vector<ocp_timeline_event> & events() const
+    { return m_events; }
+
+  // Events with FROM <= time < TO.  Events without time are not included.
+  std::pair<const_iterator, const_iterator> time_range(uint64_t from, uint64_t to) const;
+
+  // Append events of class CLASS_TYPE with FROM <= time < TO to RESULT.
+  void find(uint8_t class_type, uint64_t from, uint64_t to,
+            std::vector<const ocp_timeline_event *> & result) const;
+
+  // Time of the last event, 0 if none.
+  uint64_t last_time() const;
+
+private:
+  std::vector<ocp_timeline_event> m_events;
+  // Indices into m_events for each event class, in time order
+  std::vector<std::vector<unsigned>> m_class_index;
+
+  void build_index();
+};
+
+// Result of ocp_stat_delta().
+enum ocp_stat_delta_status
+{
+  OCP_DELTA_OK,         // Delta is valid
+  OCP_DELTA_RESET,      // Counter was reset, delta is the increase since the reset
+  OCP_DELTA_SATURATED,  // Counter saturated, delta is a lower limit
+  OCP_DELTA_UNKNOWN,    // Counter saturated before or decreased unexpectedly
+  OCP_DELTA_NO_COUNTER  // Behavior type is not a counter
+};
+
+// Return true if BEHAVIOR_TYPE describes a saturating counter and UNIT
+// is not the unit of a gauge (temperature, voltage, current, ...).
+bool ocp_stat_is_counter(uint8_t behavior_type, uint8_t unit);
+
+// Compute the increase of a saturating counter statistic from OLD_VAL to
+// NEW_VAL.  The counter saturates at the maximum value of DATA_SIZE bytes.
+// BEHAVIOR_TYPE selects whether it is reset by a power cycle.
+ocp_stat_delta_status ocp_stat_delta(uint8_t behavior_type, size_t data_size,
+                                     uint64_t old_val, uint64_t new_val, uint64_t * delta);
+
+// Time series of the single integer statistics found in statistic
+// snapshot events.  Each statistic ID is stored in columns of times
+// and values.
+class ocp_stat_time_series
+{
+public:
+  struct series {
+    uint16_t id = 0;
+    uint8_t data_type = OCP_DATA_TYPE_UINT; // OCP_DATA_TYPE_INT or _UINT
+    uint8_t behavior_type = 0;
+    uint8_t unit = 0;
+    std::vector<uint64_t> times; // Milliseconds, ascending
+    std::vector<uint64_t> values; // OCP_DATA_TYPE_INT: int64_t values
+
+    size_t size() const
+      { return times.size(); }
+    int64_t int_value(size_t i) const
+      { return (int64_t)values[i]; }
+  };
+
+  // Add the samples of the statistic snapshot events of TIMELINE.
+  // Events without time and statistics which are no single integer
+  // values are ignored.  Return the number of samples added.
+  unsigned add(const ocp_event_timeline & timeline);
+
+  void clear()
+    { m_series.clear(); }
+
+  // All series ordered by statistic ID.
+  const std::vector<series> & all() const
+    { return m_series; }
+
+  // Series of statistic ID, nullptr if none.
+  const series * find(uint16_t id) const;
+
+private:
+  std::vector<series> m_series;
+};
 
-bool read_ata_ocp_telemetry_statistics(ata_device * device, unsigned nsectors,
-                                       struct ata_device_internal_status *internal_status,
-                                       struct ocp_telemetry_data_header *ocp_data_header,
-                                       char **stats);
 } // namespace smartmon
 
 #endif // OCPTELEMETRY_H
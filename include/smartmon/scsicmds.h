@@ -69,6 +69,12 @@ namespace smartmon {
 #ifndef READ_DEFECT_12
 #define READ_DEFECT_12  0xb7
 #endif
+#ifndef READ_BUFFER_10
+#define READ_BUFFER_10  0x3c
+#endif
+#ifndef READ_BUFFER_16
+#define READ_BUFFER_16  0x9b
+#endif
 #ifndef START_STOP_UNIT         /* SSU */
 #define START_STOP_UNIT  0x1b
 #endif
@@ -485,6 +491,9 @@ int scsiReadDefect12(scsi_device * device, int req_plist, int req_glist,
                      int dl_format, int addrDescIndex, uint8_t *pBuf,
                      int bufLen);
 
+int scsiReadBuffer(scsi_device * device, int mode, int buffer_id,
+                   uint64_t offset, uint8_t *pBuf, int bufLen);
+
 int scsiReadCapacity10(scsi_device * device, unsigned int * last_lbp,
                        unsigned int * lb_sizep);
 
@@ -0,0 +1,342 @@
+/*
+ * drivedbbench.cpp - benchmark of drive database load and lookup (libsmartmon example program)
+ *
+ * Home page of code is: https://www.smartmontools.org
+ *
+ * Copyright (C) 2026 Western Digital Corporation or its affiliates.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <smartmon/atacmds.h>
+#include <smartmon/dev_interface.h>
+#include <smartmon/knowndrives.h>
+#include <smartmon/utility.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int usage(const char * prog, int status)
+{
+  std::printf("%s\n"
+    "Benchmark of the libsmartmon drive database load and lookup\n\n"
+    "Usage: %s [-B [+]FILE] [-m FILE] [-n COUNT] [-r REPEAT]\n\n"
+    "    -B [+]FILE Read and replace [add] drive database from FILE\n"
+    "               (default: standard places or builtin database)\n"
+    "    -m FILE    Read models from FILE, one 'MODEL[<TAB>FIRMWARE]' per line\n"
+    "               (default: synthetic list derived from builtin models)\n"
+    "    -n COUNT   Number of synthetic models and USB IDs (default: 5000)\n"
+    "    -r REPEAT  Number of lookups of each model and USB ID (default: 3)\n"
+    "    -h         Print this help\n"
+    "    -V         Print version information\n\n"
+    "The database is loaded once per process.  Run the program once with and\n"
+    "once without '-B FILE' to compare builtin and external databases.\n"
+    "Lookup latencies are reported in microseconds.\n",
+    smartmon::format_version_info("drivedbbench").c_str(), prog);
+    return status;
+}
+
+// Model and firmware strings of real drives, see 'tested with' comments
+// in drivedb.h.
+static const char * const real_models[][2] = {
+  { "WDC WD40EFRX-68N32N0", "82.00A82" },
+  { "WDC WD3200BEVS-08VAT2", "14.01A14" },
+  { "WDC WD2002FYPS-02W3B0", "04.01G01" },
+  { "WDC WD7500AADS-00M2B0", "01.00A01" },
+  { "WDC WD1005FBYZ-01YCBB1", "RR04" },
+  { "ST4000DM004-2CV104", "0001" },
+  { "ST3000DM001-9YN166", "CC4H" },
+  { "ST31000340NS", "SN06" },
+  { "ST3000NC000", "CE02" },
+  { "ST4000DM006-2G5107", "DN02" },
+  { "ST500LM000-1EJ162", "SM11" },
+  { "ST31000520AS", "CC32" },
+  { "HGST HMS5C4040ALE640", "MPAOA580" },
+  { "HGST HUS726T6TALE6L4", "VKGNW40H" },
+  { "HITACHI HTS722016K9SA00", "DCDZC75A" },
+  { "HITACHI HTS725050A7E630", "GH2ZB390" },
+  { "TOSHIBA MK2576GSX", "GS001A" },
+  { "TOSHIBA MK1002TSKB", "MT1A" },
+  { "TOSHIBA Q300 Pro.", "JYRA0101" },
+  { "FUJITSU MHT2030AC", "909B" },
+  { "FUJITSU MHZ2160BJ G1", "00840022" },
+  { "SV1604N", "TR100" },
+  { "HD160JJ", "ZM100" },
+  { "HD103UI", "1AA01113" },
+  { "Samsung SSD 860 EVO 500GB", "RVT01B6Q" },
+  { "INTEL SSDSC2CW120A3", "400i" },
+  { "Micron_M510DC_MTFDDAK240MBP", "0005" },
+  { "Micron_5100_MTFDDAK3T8TCB", "D0MU410" },
+  { "Micron_M600_MTFDDAK1T0MBF", "MU01" },
+  { "Micron 1100 SATA 256GB", "M0DL022" },
+  { "M550-MTFDDAK256MAY", "MU01" },
+  { "P300-MTFDDAC100SAL", "0003" },
+  { "CT250MX500SSD1", "M3CR010" },
+  { "Crucial_CT256MX100SSD1", "MU01" },
+  { "M4-CT512M4SSD2", "0309" },
+  { "KINGSTON SHFS37A240G", "608ABBF0" },
+  { "KINGSTON SUV300S37A120G", "SAFM11.K" },
+  { "OCZ VERTEX-PLUS", "3.55" },
+  { "OCZ-TRION100", "SAFM11.2A" },
+  { "Corsair Force LS SSD", "S9FM01.8" },
+  { "GOODRAM IRIDIUM PRO", "SAFM01.5" },
+  { "SPCC Solid State Disk", "SBFD00.3" },
+  { "ADATA XM11 128GB", "5.0.1" },
+  { "VK001920GWSXK", "HPG3" },
+  { "APSDM016GA2AN-PTM1", "SFDK004A" },
+  { "TS25M64MLC64GSSD", "0.1" },
+  { "Radeon R7", "1.00" },
+  { "Hoodisk SSD", "SBFM01.3" },
+};
+
+// USB vendor:product IDs of real devices, see drivedb.h.
+static const unsigned short real_usb_ids[][2] = {
+  { 0x03f0, 0xbd07 }, { 0x0402, 0x5621 }, { 0x04b4, 0x6830 }, { 0x04cf, 0x8818 },
+  { 0x04e8, 0x61b6 }, { 0x054c, 0x05bf }, { 0x059f, 0x1010 }, { 0x059f, 0x104a },
+  { 0x05ab, 0x0060 }, { 0x05e3, 0x0718 }, { 0x0634, 0x0655 }, { 0x067b, 0x2773 },
+  { 0x07ab, 0xfc88 }, { 0x0951, 0x1780 }, { 0x0bc2, 0x2300 }, { 0x0bda, 0x9210 },
+  { 0x0c0b, 0xb159 }, { 0x0d49, 0x7450 }, { 0x1006, 0x3002 }, { 0x1058, 0x0701 },
+  { 0x152d, 0x0539 }, { 0x152d, 0x0578 }, { 0x174c, 0x55aa }, { 0x2109, 0x0715 },
+};
+
+// Simple deterministic pseudo random numbers.
+static unsigned rnd(unsigned n)
+{
+  static unsigned state = 12345;
+  state = state * 1103515245U + 12345U;
+  return (state >> 8) % n;
+}
+
+struct model_info {
+  std::string model, firmware;
+};
+
+// Create synthetic variants of the real models.  Digits are randomly
+// changed to get a mix of known and unknown models.
+static void make_models(unsigned count, std::vector<model_info> & models)
+{
+  const unsigned nreal = sizeof(real_models) / sizeof(real_models[0]);
+  for (unsigned i = 0; i < count; i++) {
+    model_info mi;
+    mi.model = real_models[i % nreal][0];
+    mi.firmware = real_models[i % nreal][1];
+    if (i >= nreal) {
+      for (char & c : mi.model) {
+        if ('0' <= c && c <= '9' && !rnd(4))
+          c = '0' + rnd(10);
+      }
+      if (!rnd(10))
+        mi.model = "UNKNOWN " + mi.model;
+    }
+    models.push_back(mi);
+  }
+}
+
+// Read models from file.
+static bool read_models(const char * path, std::vector<model_info> & models)
+{
+  FILE * f = std::fopen(path, "r");
+  if (!f) {
+    std::perror(path);
+    return false;
+  }
+  char line[256];
+  while (std::fgets(line, sizeof(line), f)) {
+    line[std::strcspn(line, "\r\n")] = 0;
+    if (!line[0])
+      continue;
+    model_info mi;
+    const char * tab = std::strchr(line, '\t');
+    mi.model.assign(line, tab ? tab - line : std::strlen(line));
+    if (tab)
+      mi.firmware = tab + 1;
+    models.push_back(mi);
+  }
+  std::fclose(f);
+  return true;
+}
+
+struct usb_id_info {
+  int vendor_id, product_id, bcd_device;
+};
+
+// Create synthetic USB IDs, either real or with random product ID.
+static void make_usb_ids(unsigned count, std::vector<usb_id_info> & ids)
+{
+  const unsigned nreal = sizeof(real_usb_ids) / sizeof(real_usb_ids[0]);
+  for (unsigned i = 0; i < count; i++) {
+    usb_id_info ui;
+    ui.vendor_id = real_usb_ids[i % nreal][0];
+    ui.product_id = real_usb_ids[i % nreal][1];
+    if (i >= nreal && !rnd(2))
+      ui.product_id = rnd(0x10000);
+    ui.bcd_device = (!rnd(2) ? -1 : (int)rnd(0x10000));
+    ids.push_back(ui);
+  }
+}
+
+// Set ATA IDENTIFY DEVICE strings, bytes are swapped as sent by the device.
+static void set_id_string(unsigned char * dest, const std::string & src, unsigned size)
+{
+  char buf[64];
+  std::memset(buf, ' ', size);
+  std::memcpy(buf, src.data(), std::min<size_t>(src.size(), size));
+  for (unsigned i = 0; i < size; i += 2) {
+    dest[i] = buf[i + 1]; dest[i + 1] = buf[i];
+  }
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_us(bench_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+static bool lookup_model(const model_info & mi)
+{
+  smartmon::ata_identify_device id;
+  std::memset(&id, 0, sizeof(id));
+  set_id_string(id.model, mi.model, sizeof(id.model));
+  set_id_string(id.fw_rev, mi.firmware, sizeof(id.fw_rev));
+  smartmon::ata_vendor_attr_defs defs;
+  smartmon::firmwarebug_defs firmwarebugs;
+  std::string dbversion;
+  return !!smartmon::lookup_drive_apply_presets(&id, defs, firmwarebugs, dbversion);
+}
+
+static bool lookup_usb(const usb_id_info & ui)
+{
+  smartmon::usb_dev_info info, info2;
+  return (smartmon::lookup_usb_device(ui.vendor_id, ui.product_id, ui.bcd_device,
+                                      info, info2) > 0);
+}
+
+// Print count, mean and percentiles of latencies TIMES.
+static void print_latencies(const char * name, std::vector<double> & times, unsigned found)
+{
+  std::sort(times.begin(), times.end());
+  double sum = 0;
+  for (double t : times)
+    sum += t;
+  unsigned n = times.size();
+  std::printf("%-12s %8u %8u %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, n, found,
+              sum / n, times[n / 2], times[n * 90 / 100], times[n * 99 / 100], times[n - 1]);
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    // Required for format_version_info()
+    smartmon::smart_interface::init();
+
+    const char * db_path = nullptr, * models_path = nullptr;
+    unsigned count = 5000, repeat = 3;
+    for (int ai = 1; ai < argc; ai++) {
+      if (!std::strcmp(argv[ai], "-B") && ai + 1 < argc)
+        db_path = argv[++ai];
+      else if (!std::strcmp(argv[ai], "-m") && ai + 1 < argc)
+        models_path = argv[++ai];
+      else if (!std::strcmp(argv[ai], "-n") && ai + 1 < argc) {
+        count = std::atoi(argv[++ai]);
+        if (!count)
+          return usage(argv[0], 1);
+      }
+      else if (!std::strcmp(argv[ai], "-r") && ai + 1 < argc) {
+        repeat = std::atoi(argv[++ai]);
+        if (!repeat)
+          return usage(argv[0], 1);
+      }
+      else if (!std::strcmp(argv[ai], "-h"))
+        return usage(argv[0], 0);
+      else if (!std::strcmp(argv[ai], "-V")) {
+        std::fputs(smartmon::format_version_info("drivedbbench", 3).c_str(), stdout);
+        return 0;
+      }
+      else
+        return usage(argv[0], 1);
+    }
+
+    std::vector<model_info> models;
+    if (models_path) {
+      if (!read_models(models_path, models))
+        return 1;
+      if (models.empty()) {
+        std::fprintf(stderr, "%s: no models found\n", models_path);
+        return 1;
+      }
+    }
+    else
+      make_models(count, models);
+    std::vector<usb_id_info> usb_ids;
+    make_usb_ids(count, usb_ids);
+
+    // Load database as done by smartctl
+    bench_clock::time_point start = bench_clock::now();
+    bool use_default_db = true;
+    if (db_path) {
+      if (*db_path == '+' && db_path[1])
+        db_path++;
+      else
+        use_default_db = false;
+      if (!smartmon::read_drive_database(db_path))
+        return 1;
+    }
+    if (!smartmon::init_drive_database(use_default_db))
+      return 1;
+    double load_us = elapsed_us(start);
+
+    // First lookups include creation of indexes and compiled regexps
+    start = bench_clock::now();
+    lookup_model(models[0]);
+    double first_model_us = elapsed_us(start);
+    start = bench_clock::now();
+    lookup_usb(usb_ids[0]);
+    double first_usb_us = elapsed_us(start);
+
+    std::printf("Database: %s%s\n", (db_path ? db_path : "default"),
+                (db_path && use_default_db ? " + default" : ""));
+    std::printf("%-24s %10.3f ms\n", "init_drive_database", load_us / 1000);
+    std::printf("%-24s %10.3f ms\n", "first ATA lookup", first_model_us / 1000);
+    std::printf("%-24s %10.3f ms\n", "first USB lookup", first_usb_us / 1000);
+    std::printf("%-24s %10.3f ms\n\n", "total startup",
+                (load_us + first_model_us + first_usb_us) / 1000);
+
+    std::vector<double> times;
+    times.reserve(repeat * std::max(models.size(), usb_ids.size()));
+    std::printf("%-12s %8s %8s %9s %9s %9s %9s %9s\n", "lookup", "count", "found",
+                "mean", "p50", "p90", "p99", "max");
+
+    unsigned found = 0;
+    for (unsigned r = 0; r < repeat; r++) {
+      for (const model_info & mi : models) {
+        start = bench_clock::now();
+        bool ok = lookup_model(mi);
+        times.push_back(elapsed_us(start));
+        found += ok;
+      }
+    }
+    print_latencies("ATA", times, found);
+
+    times.clear(); found = 0;
+    for (unsigned r = 0; r < repeat; r++) {
+      for (const usb_id_info & ui : usb_ids) {
+        start = bench_clock::now();
+        bool ok = lookup_usb(ui);
+        times.push_back(elapsed_us(start));
+        found += ok;
+      }
+    }
+    print_latencies("USB", times, found);
+    return 0;
+  }
+  catch (std::exception & ex) {
+    std::fprintf(stderr, "Exception: %s\n", ex.what());
+    return 1;
+  }
+}
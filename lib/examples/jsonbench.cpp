@@ -0,0 +1,391 @@
+/*
+ * jsonbench.cpp - microbenchmarks of the JSON builder and printers (libsmartmon example program)
+ *
+ * Home page of code is: https://www.smartmontools.org
+ *
+ * Copyright (C) 2026 Western Digital Corporation or its affiliates.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <smartmon/dev_interface.h>
+#include <smartmon/json.h>
+#include <smartmon/utility.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+using smartmon::json;
+
+// Allocation counters, updated by the replaced global operator new.
+static uint64_t alloc_count = 0, alloc_bytes = 0;
+
+void * operator new(std::size_t size)
+{
+  alloc_count++;
+  alloc_bytes += size;
+  void * p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void * p, std::size_t /*size*/) noexcept
+{
+  std::free(p);
+}
+#endif
+
+static int usage(const char * prog, int status)
+{
+  std::printf("%s\n"
+    "Microbenchmarks of the libsmartmon JSON builder and printers\n\n"
+    "Usage: %s [-t MSEC] [-l] [NAME...]\n\n"
+    "    -t MSEC    Minimum run time of each benchmark (default: 500)\n"
+    "    -l         List benchmarks and exit\n"
+    "    -h         Print this help\n"
+    "    -V         Print version information\n\n"
+    "NAME selects all benchmarks with this prefix.  Results are reported\n"
+    "per operation: run time, bytes and number of heap allocations, and\n"
+    "output bytes of the print benchmarks.\n",
+    smartmon::format_version_info("jsonbench").c_str(), prog);
+    return status;
+}
+
+// Output file of the print benchmarks.
+static FILE * null_file = nullptr;
+
+// Output bytes of print() if measure_output is set.
+static bool measure_output = false;
+static long print_bytes = 0;
+
+// Print JS to the null device or measure the output size.
+static void print_json(const json & js, const json::print_options & opts)
+{
+  FILE * f;
+  if (!measure_output || !(f = std::tmpfile())) {
+    js.print(null_file, opts);
+    return;
+  }
+  js.print(f, opts);
+  std::fflush(f);
+  print_bytes = std::ftell(f);
+  std::fclose(f);
+}
+
+// Add an SMART attribute table similar to 'smartctl -A'.
+static void add_attributes(json & js)
+{
+  static const char * const names[] = {
+    "Raw_Read_Error_Rate", "Spin_Up_Time", "Start_Stop_Count", "Reallocated_Sector_Ct",
+    "Seek_Error_Rate", "Power_On_Hours", "Spin_Retry_Count", "Power_Cycle_Count",
+    "Power-Off_Retract_Count", "Load_Cycle_Count", "Temperature_Celsius",
+    "Reallocated_Event_Count", "Current_Pending_Sector", "Offline_Uncorrectable",
+    "UDMA_CRC_Error_Count", "Multi_Zone_Error_Rate"
+  };
+  json::ref jtab = js["ata_smart_attributes"]["table"];
+  for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    json::ref ja = jtab[i];
+    ja["id"] = i * 3 + 1;
+    ja["name"] = names[i];
+    ja["value"] = 100;
+    ja["worst"] = 100 - i;
+    ja["thresh"] = (i & 1 ? 0 : 6);
+    ja["when_failed"] = "";
+    json::ref jf = ja["flags"];
+    jf["value"] = 0x0032;
+    jf["string"] = "-O--CK ";
+    jf["prefailure"] = false;
+    jf["updated_online"] = true;
+    jf["performance"] = false;
+    jf["error_rate"] = false;
+    jf["event_count"] = true;
+    jf["auto_keep"] = true;
+    json::ref jr = ja["raw"];
+    jr["value"] = 1000000ULL * i;
+    jr["string"] = smartmon::strprintf("%u", 1000000U * i);
+  }
+}
+
+// Add a typical device document with a large log.
+static void add_device_document(json & js)
+{
+  js["json_format_version"][0] = 1;
+  js["json_format_version"][1] = 0;
+  js["device"] += { { "name", "/dev/sda" }, { "info_name", "/dev/sda [SAT]" },
+                    { "type", "sat" }, { "protocol", "ATA" } };
+  js["model_name"] = "Example Model 12345";
+  js["serial_number"] = "ABC123456789";
+  js["user_capacity"]["bytes"].set_unsafe_uint64(18000207937536ULL);
+  js["smart_status"]["passed"] = true;
+  add_attributes(js);
+  json::ref jlog = js["ata_smart_error_log"]["extended"]["table"];
+  for (int i = 0; i < 500; i++) {
+    json::ref je = jlog[i];
+    je["error_number"] = 500 - i;
+    je["lifetime_hours"] = 20000 + i;
+    je["error_description"] = "Error: UNC at LBA = 0x0fffffff = 268435455";
+    json::ref jc = je["previous_commands"];
+    for (int j = 0; j < 5; j++) {
+      json::ref jcmd = jc[j];
+      jcmd["command_name"] = "READ FPDMA QUEUED";
+      jcmd["powerup_milliseconds"] = 1000000 + i * 100 + j;
+    }
+  }
+  json::ref jhex = js["hex_dump"];
+  for (int i = 0; i < 4096; i++)
+    jhex[i] = smartmon::strprintf("%04x: 00 11 22 33 44 55 66 77 88 99 aa bb cc dd ee ff", i * 16);
+}
+
+// Benchmarks, each runs N operations.
+
+static void bench_build_deep(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    for (int k = 0; k < 100; k++)
+      js["level1"]["level2"]["level3"]["level4"]["level5"]["level6"]["value"][k] = k;
+  }
+}
+
+static void bench_build_wide(unsigned n)
+{
+  char key[32];
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    json::ref jref = js["wide"];
+    for (int k = 0; k < 1000; k++) {
+      std::snprintf(key, sizeof(key), "key_%04d", (k * 7919) % 1000);
+      jref[key] = k;
+    }
+  }
+}
+
+static void bench_build_array_scalars(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    json::ref jref = js["array"];
+    for (int k = 0; k < 10000; k++)
+      jref[k] = k;
+  }
+}
+
+static void bench_build_array_objects(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    json::ref jref = js["array"];
+    for (int k = 0; k < 1000; k++) {
+      json::ref je = jref[k];
+      je["index"] = k;
+      je["name"] = "element";
+      je["value"] = 1000ULL * k;
+      je["valid"] = true;
+    }
+  }
+}
+
+static void bench_build_attributes(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    add_attributes(js);
+  }
+}
+
+static void bench_build_document(unsigned n)
+{
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    add_device_document(js);
+  }
+}
+
+static void bench_str2key(unsigned n)
+{
+  static const char * const strs[] = {
+    "Power_On_Hours", "Media and Data Integrity Errors", "Temperature Sensor 1",
+    "Percentage Used", "Host_Writes_32MiB", "Unsafe Shutdowns"
+  };
+  const unsigned nstrs = sizeof(strs) / sizeof(strs[0]);
+  size_t len = 0;
+  for (unsigned i = 0; i < n; i++)
+    len += json::str2key(strs[i % nstrs]).size();
+  if (!len)
+    std::abort();
+}
+
+static void print_document(unsigned n, char format, bool pretty, bool sorted)
+{
+  static json js;
+  if (!js.is_enabled()) {
+    js.enable();
+    add_device_document(js);
+  }
+  json::print_options opts;
+  opts.format = format; opts.pretty = pretty; opts.sorted = sorted;
+  for (unsigned i = 0; i < n; i++)
+    print_json(js, opts);
+}
+
+static void bench_print_json_pretty(unsigned n)
+  { print_document(n, 0, true, false); }
+static void bench_print_json_compact(unsigned n)
+  { print_document(n, 0, false, false); }
+static void bench_print_json_sorted(unsigned n)
+  { print_document(n, 0, true, true); }
+static void bench_print_yaml(unsigned n)
+  { print_document(n, 'y', true, false); }
+static void bench_print_yaml_sorted(unsigned n)
+  { print_document(n, 'y', true, true); }
+static void bench_print_flat(unsigned n)
+  { print_document(n, 'g', true, false); }
+static void bench_print_flat_sorted(unsigned n)
+  { print_document(n, 'g', true, true); }
+static void bench_print_cbor(unsigned n)
+  { print_document(n, 'b', false, false); }
+
+// Build and print document with streamed arrays, as done by smartctl.
+static void bench_stream_document(unsigned n)
+{
+  json::print_options opts;
+  opts.pretty = true;
+  for (unsigned i = 0; i < n; i++) {
+    json js; js.enable();
+    js.enable_streaming(opts.pretty);
+    json::ref jhex = js["hex_dump"].stream();
+    for (int k = 0; k < 4096; k++)
+      jhex[k] = smartmon::strprintf("%04x: 00 11 22 33 44 55 66 77 88 99 aa bb cc dd ee ff", k * 16);
+    print_json(js, opts);
+  }
+}
+
+struct benchmark {
+  const char * name;
+  void (*func)(unsigned n);
+};
+
+static const benchmark benchmarks[] = {
+  { "build_deep",           bench_build_deep },
+  { "build_wide",           bench_build_wide },
+  { "build_array_scalars",  bench_build_array_scalars },
+  { "build_array_objects",  bench_build_array_objects },
+  { "build_attributes",     bench_build_attributes },
+  { "build_document",       bench_build_document },
+  { "str2key",              bench_str2key },
+  { "print_json_pretty",    bench_print_json_pretty },
+  { "print_json_compact",   bench_print_json_compact },
+  { "print_json_sorted",    bench_print_json_sorted },
+  { "print_yaml",           bench_print_yaml },
+  { "print_yaml_sorted",    bench_print_yaml_sorted },
+  { "print_flat",           bench_print_flat },
+  { "print_flat_sorted",    bench_print_flat_sorted },
+  { "print_cbor",           bench_print_cbor },
+  { "stream_document",      bench_stream_document },
+};
+
+// Run benchmark until MIN_NS is reached, print results.
+static void run(const benchmark & b, double min_ns)
+{
+  typedef std::chrono::steady_clock clock;
+  // Warm up, also creates static data and measures output size
+  print_bytes = 0;
+  measure_output = true;
+  b.func(1);
+  measure_output = false;
+  for (unsigned n = 1; ; ) {
+    uint64_t count0 = alloc_count, bytes0 = alloc_bytes;
+    clock::time_point start = clock::now();
+    b.func(n);
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    if (ns >= min_ns || n >= 1000000000U) {
+      std::printf("%-22s %10u %14.1f %12.1f %10.1f", b.name, n, ns / n,
+                  (double)(alloc_bytes - bytes0) / n, (double)(alloc_count - count0) / n);
+      if (print_bytes)
+        std::printf(" %10ld", print_bytes);
+      std::printf("\n");
+      std::fflush(stdout);
+      return;
+    }
+    // Estimate iterations for MIN_NS, at most 100x
+    double f = (ns > 0 ? 1.2 * min_ns / ns : 100);
+    n = (f >= 100 ? n * 100 : (unsigned)(n * f) + 1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    // Required for format_version_info()
+    smartmon::smart_interface::init();
+
+    double min_ms = 500;
+    int ai;
+    for (ai = 1; ai < argc && argv[ai][0] == '-'; ai++) {
+      if (!std::strcmp(argv[ai], "-t") && ai + 1 < argc) {
+        min_ms = std::atof(argv[++ai]);
+        if (!(min_ms > 0))
+          return usage(argv[0], 1);
+      }
+      else if (!std::strcmp(argv[ai], "-l")) {
+        for (const benchmark & b : benchmarks)
+          std::printf("%s\n", b.name);
+        return 0;
+      }
+      else if (!std::strcmp(argv[ai], "-h")) {
+        return usage(argv[0], 0);
+      }
+      else if (!std::strcmp(argv[ai], "-V")) {
+        std::fputs(smartmon::format_version_info("jsonbench", 3).c_str(), stdout);
+        return 0;
+      }
+      else {
+        return usage(argv[0], 1);
+      }
+    }
+
+#ifdef _WIN32
+    null_file = std::fopen("nul", "wb");
+#else
+    null_file = std::fopen("/dev/null", "wb");
+#endif
+    if (!null_file) {
+      std::perror("null device");
+      return 1;
+    }
+
+    std::printf("%-22s %10s %14s %12s %10s %10s\n", "benchmark", "ops",
+                "ns/op", "bytes/op", "allocs/op", "output");
+    int status = 1;
+    for (const benchmark & b : benchmarks) {
+      if (ai < argc) {
+        bool match = false;
+        for (int i = ai; i < argc && !match; i++)
+          match = !std::strncmp(b.name, argv[i], std::strlen(argv[i]));
+        if (!match)
+          continue;
+      }
+      run(b, min_ms * 1000000);
+      status = 0;
+    }
+    if (status)
+      std::fprintf(stderr, "No matching benchmark\n");
+    return status;
+  }
+  catch (std::exception & ex) {
+    std::fprintf(stderr, "Exception: %s\n", ex.what());
+    return 1;
+  }
+}
@@ -0,0 +1,399 @@
+/*
+ * ocpdecode.cpp - decode OCP telemetry captures in parallel (libsmartmon example program)
+ *
+ * Home page of code is: https://www.smartmontools.org
+ *
+ * Copyright (C) 2026 Western Digital Corporation or its affiliates.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <smartmon/dev_interface.h>
+#include <smartmon/ocptelemetry.h>
+#include <smartmon/utility.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static int usage(const char * prog, int status)
+{
+  std::printf("%s\n"
+    "Decode OCP telemetry captures, one record per statistic or event\n\n"
+    "Usage: %s [-f FORMAT] [-j N] FILE|DIR...\n\n"
+    "    -f FORMAT  Output format: ndjson (default), csv\n"
+    "    -j N       Number of threads (default: number of CPUs)\n"
+    "    -h         Print this help\n"
+    "    -V         Print version information\n\n"
+    "FILE is a capture written by 'smartctl -l ocptelemetry,save=FILE' or a\n"
+    "raw image of GP log 0x24 named NAME.0x24 with the image of GP log 0x25\n"
+    "in NAME.0x25.  Directories are searched recursively, symbolic links\n"
+    "to directories are only followed if given on the command line.\n",
+    smartmon::format_version_info("ocpdecode").c_str(), prog);
+    return status;
+}
+
+// Reads log pages from raw log images in memory.
+class raw_log_reader
+: public smartmon::ocp_log_reader
+{
+public:
+  std::vector<uint8_t> log_0x24, log_0x25;
+
+  virtual bool read_pages(unsigned char logaddr, unsigned page, void * data,
+                          unsigned nsectors) override
+    {
+      const std::vector<uint8_t> & log = (logaddr == 0x24 ? log_0x24 : log_0x25);
+      size_t start = page * 512, size = nsectors * 512;
+      if (!(start <= log.size() && size <= log.size() - start))
+        return false;
+      std::memcpy(data, log.data() + start, size);
+      return true;
+    }
+};
+
+static bool read_file(const std::string & filename, std::vector<uint8_t> & data,
+                      std::string & errmsg)
+{
+  smartmon::stdio_file f(filename.c_str(), "rb");
+  if (!f) {
+    errmsg = filename + ": " + std::strerror(errno);
+    return false;
+  }
+  data.clear();
+  uint8_t buf[64 * 1024];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  if (std::ferror(f)) {
+    errmsg = filename + ": Read error";
+    return false;
+  }
+  return true;
+}
+
+enum output_format { FMT_NDJSON, FMT_CSV };
+
+// Return true if all UTF-8 sequences in STR are valid.
+static bool is_valid_utf8(const char * str)
+{
+  int state = 0;
+  for (const char * p = str; *p; p++) {
+    unsigned char c = (unsigned char)*p;
+    if ((c & 0xc0) == 0x80) {
+      if (--state < 0)
+        return false;
+    }
+    else {
+      if (state != 0)
+        return false;
+      if (!(c & 0x80))
+        ;
+      else if ((c & 0xe0) == 0xc0 && (c & 0x1f))
+        state = 1;
+      else if ((c & 0xf0) == 0xe0 && (c & 0x0f))
+        state = 2;
+      else if ((c & 0xf8) == 0xf0 && (c & 0x07))
+        state = 3;
+      else
+        return false;
+    }
+  }
+  return (state == 0);
+}
+
+// Append string as JSON or CSV value.
+static void append_str(std::string & out, output_format fmt, const char * str)
+{
+  // Print as UTF-8 unless the string contains any invalid sequences,
+  // use the informal hex string from json.cpp otherwise
+  bool utf8_ok = (fmt == FMT_CSV || is_valid_utf8(str));
+  out += '"';
+  for (const char * p = str; *p; p++) {
+    unsigned char c = (unsigned char)*p;
+    if (fmt == FMT_CSV) {
+      if (c == '"')
+        out += '"';
+      out += (char)c;
+    }
+    else if (c == '"' || c == '\\') {
+      out += '\\';
+      out += (char)c;
+    }
+    else if (c < 0x20)
+      out += smartmon::strprintf("\\u%04x", c);
+    else if ((c & 0x80) && !utf8_ok)
+      out += smartmon::strprintf("\\\\x%02x", c);
+    else
+      out += (char)c;
+  }
+  out += '"';
+}
+
+// One decoded statistic or event.
+struct record {
+  const char * type;  // "statistic" or "event"
+  unsigned area;      // Statistic area or event FIFO
+  unsigned index;     // Index of descriptor in area
+  bool time_valid;
+  uint64_t time;
+  int event_class;    // -1 for statistics
+  uint16_t id;
+  const char * name;  // May be empty
+  const char * value; // May be empty
+};
+
+static void append_record(std::string & out, output_format fmt, const std::string & file,
+                          const record & r)
+{
+  if (fmt == FMT_CSV) {
+    append_str(out, fmt, file.c_str());
+    out += smartmon::strprintf(",%s,%u,%u,", r.type, r.area, r.index);
+    if (r.time_valid)
+      out += smartmon::strprintf("%" PRIu64, r.time);
+    out += ',';
+    if (r.event_class >= 0)
+      out += smartmon::strprintf("%d", r.event_class);
+    out += smartmon::strprintf(",%u,", r.id);
+    append_str(out, fmt, r.name);
+    out += ',';
+    out += r.value;
+    out += '\n';
+    return;
+  }
+
+  out += "{\"file\":";
+  append_str(out, fmt, file.c_str());
+  out += smartmon::strprintf(",\"type\":\"%s\",\"%s\":%u,\"index\":%u", r.type,
+                             (r.event_class < 0 ? "area" : "fifo"), r.area, r.index);
+  if (r.time_valid)
+    out += smartmon::strprintf(",\"time\":%" PRIu64, r.time);
+  if (r.event_class >= 0)
+    out += smartmon::strprintf(",\"class\":%d", r.event_class);
+  out += smartmon::strprintf(",\"id\":%u", r.id);
+  if (*r.name) {
+    out += ",\"name\":";
+    append_str(out, fmt, r.name);
+  }
+  if (*r.value) {
+    out += ",\"value\":";
+    out += r.value;
+  }
+  out += "}\n";
+}
+
+// Decode one capture into OUT.  The session is reused for all files
+// of a thread, so its memory is only allocated once.
+static bool decode(const std::string & filename, output_format fmt,
+                   smartmon::ocp_telemetry_session & session, std::string & out,
+                   std::string & errmsg)
+{
+  smartmon::ocp_capture_log_reader capture;
+  raw_log_reader raw;
+  smartmon::ocp_log_reader * reader;
+  unsigned nsectors_0x24, nsectors_0x25;
+
+  size_t len = filename.size();
+  if (len > 5 && filename.compare(len - 5, 5, ".0x24") == 0) {
+    if (!(   read_file(filename, raw.log_0x24, errmsg)
+          && read_file(filename.substr(0, len - 5) + ".0x25", raw.log_0x25, errmsg)))
+      return false;
+    nsectors_0x24 = (unsigned)(raw.log_0x24.size() / 512);
+    nsectors_0x25 = (unsigned)(raw.log_0x25.size() / 512);
+    reader = &raw;
+  }
+  else {
+    if (!capture.load(filename.c_str(), errmsg))
+      return false;
+    nsectors_0x24 = capture.get_num_sectors(0x24);
+    nsectors_0x25 = capture.get_num_sectors(0x25);
+    reader = &capture;
+  }
+  if (nsectors_0x24 < 2 || nsectors_0x25 < 2) {
+    errmsg = filename + ": GP Log 0x24 or 0x25 missing";
+    return false;
+  }
+
+  session.reset();
+  if (!(   session.read_strings(*reader, nsectors_0x25)
+         && session.read_data(*reader, nsectors_0x24))) {
+    errmsg = filename + ": Invalid OCP telemetry data";
+    return false;
+  }
+
+  char value[32];
+  for (unsigned a = 0; a < 2; a++) {
+    const smartmon::ocp_telemetry_session::area & area = session.statistic_areas[a];
+    unsigned idx = 0;
+    for (const smartmon::ocp_stat_desc_view & sv
+         : smartmon::ocp_stat_desc_range(area.data, area.dwords)) {
+      uint64_t uval; int64_t ival;
+      value[0] = 0;
+      if (sv.data_type() == smartmon::OCP_DATA_TYPE_UINT && sv.get_uint(&uval))
+        std::snprintf(value, sizeof(value), "%" PRIu64, uval);
+      else if (sv.data_type() == smartmon::OCP_DATA_TYPE_INT && sv.get_int(&ival))
+        std::snprintf(value, sizeof(value), "%" PRId64, ival);
+
+      std::string name;
+      const char * desc = smartmon::ocp_builtin_stat_id_to_str(sv.id());
+      smartmon::ocp_string_ref ref;
+      if (desc)
+        name = desc;
+      else if (smartmon::ocp_find_stat_id_string(&session.string_def, sv.id(), &ref))
+        name.assign(ref.str, ref.len);
+
+      record r = { "statistic", a + 1, idx++, false, 0, -1, sv.id(), name.c_str(), value };
+      append_record(out, fmt, filename, r);
+    }
+  }
+
+  smartmon::ocp_event_timeline timeline;
+  for (unsigned f = 0; f < 2; f++) {
+    const smartmon::ocp_telemetry_session::area & area = session.event_fifos[f];
+    if (area.data)
+      timeline.add_fifo(f + 1, area.data, area.dwords);
+  }
+  for (const smartmon::ocp_timeline_event & e : timeline.events()) {
+    std::string name;
+    smartmon::ocp_string_ref ref;
+    if (smartmon::ocp_find_event_string(&session.string_def, e.desc.class_type(),
+                                        e.desc.id_bytes(), &ref))
+      name.assign(ref.str, ref.len);
+
+    record r = { "event", e.fifo, e.index, e.time_valid, e.time, e.desc.class_type(),
+                 e.desc.id(), name.c_str(), "" };
+    append_record(out, fmt, filename, r);
+  }
+  return true;
+}
+
+// Add FILE or all files below directory FILE to FILES.
+// Symbolic links to directories are not followed below the top level
+// to avoid endless recursion on link cycles.
+static void add_files(const std::string & file, std::vector<std::string> & files,
+                      bool top_level = true)
+{
+  struct stat st;
+#ifndef _WIN32
+  if (!top_level && !lstat(file.c_str(), &st) && S_ISLNK(st.st_mode)) {
+    if (!stat(file.c_str(), &st) && S_ISDIR(st.st_mode))
+      return;
+  }
+#endif
+  if (stat(file.c_str(), &st) || !S_ISDIR(st.st_mode)) {
+    // NAME.0x25 is read together with NAME.0x24
+    size_t len = file.size();
+    if (!(len > 5 && file.compare(len - 5, 5, ".0x25") == 0))
+      files.push_back(file);
+    return;
+  }
+
+  DIR * dir = opendir(file.c_str());
+  if (!dir) {
+    std::fprintf(stderr, "%s: %s\n", file.c_str(), std::strerror(errno));
+    return;
+  }
+  std::vector<std::string> names;
+  while (const struct dirent * de = readdir(dir)) {
+    if (!std::strcmp(de->d_name, ".") || !std::strcmp(de->d_name, ".."))
+      continue;
+    names.push_back(file + "/" + de->d_name);
+  }
+  closedir(dir);
+  for (const std::string & name : names)
+    add_files(name, files, false);
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    // Required for format_version_info()
+    smartmon::smart_interface::init();
+
+    output_format fmt = FMT_NDJSON;
+    unsigned num_threads = std::thread::hardware_concurrency();
+    int ai;
+    for (ai = 1; ai < argc && argv[ai][0] == '-'; ai++) {
+      if (!std::strcmp(argv[ai], "-f") && ai + 1 < argc) {
+        const char * arg = argv[++ai];
+        if (!std::strcmp(arg, "ndjson"))
+          fmt = FMT_NDJSON;
+        else if (!std::strcmp(arg, "csv"))
+          fmt = FMT_CSV;
+        else
+          return usage(argv[0], 1);
+      }
+      else if (!std::strcmp(argv[ai], "-j") && ai + 1 < argc) {
+        num_threads = (unsigned)std::atoi(argv[++ai]);
+        if (!num_threads)
+          return usage(argv[0], 1);
+      }
+      else if (!std::strcmp(argv[ai], "-h")) {
+        return usage(argv[0], 0);
+      }
+      else if (!std::strcmp(argv[ai], "-V")) {
+        std::fputs(smartmon::format_version_info("ocpdecode", 3).c_str(), stdout);
+        return 0;
+      }
+      else {
+        return usage(argv[0], 1);
+      }
+    }
+    if (ai >= argc)
+      return usage(argv[0], 1);
+
+    std::vector<std::string> files;
+    for (; ai < argc; ai++)
+      add_files(argv[ai], files);
+    if (!num_threads)
+      num_threads = 1;
+    if (num_threads > files.size())
+      num_threads = (unsigned)files.size();
+
+    if (fmt == FMT_CSV)
+      std::fputs("file,type,area,index,time,class,id,name,value\n", stdout);
+
+    // Each thread takes the next file when it is done with the last one,
+    // so large and small captures are balanced without a central queue.
+    std::atomic<size_t> next_file(0);
+    std::atomic<int> status(0);
+    std::mutex out_mutex;
+    auto worker = [&]() {
+      smartmon::ocp_telemetry_session session;
+      std::string out, errmsg;
+      for (size_t i; (i = next_file++) < files.size(); ) {
+        out.clear();
+        if (!decode(files[i], fmt, session, out, errmsg)) {
+          std::lock_guard<std::mutex> lock(out_mutex);
+          std::fprintf(stderr, "%s\n", errmsg.c_str());
+          status = 1;
+          continue;
+        }
+        std::lock_guard<std::mutex> lock(out_mutex);
+        std::fwrite(out.data(), 1, out.size(), stdout);
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < num_threads; i++)
+      threads.emplace_back(worker);
+    worker();
+    for (std::thread & t : threads)
+      t.join();
+    return status;
+  }
+  catch (std::exception & ex) {
+    std::fprintf(stderr, "Exception: %s\n", ex.what());
+    return 1;
+  }
+}
@@ -16,8 +16,10 @@
 #include <smartmon/sg_unaligned.h>
 #include <smartmon/utility.h> // regular_expression, uint128_*()
 
+#include <algorithm>
 #include <inttypes.h>
 #include <stdexcept>
+#include <string.h>
 
 namespace smartmon {
 
@@ -72,33 +74,47 @@ std::string json::str2key(const char * str)
 }
 
 json::ref::ref(json & js)
-: m_js(js)
+: m_js(js), m_base(&js.m_root_node)
 {
 }
 
 json::ref::ref(json & js, const char * keystr)
-: m_js(js)
+: m_js(js), m_base(&js.m_root_node)
 {
   jassert(keystr && *keystr);
   m_path.push_back(node_info(keystr));
 }
 
 json::ref::ref(const ref & base, const char * keystr)
-: m_js(base.m_js), m_path(base.m_path)
+: m_js(base.m_js)
 {
   jassert(keystr && *keystr);
+  if (base.find_node()) {
+    // Start at existing node, avoid path replay from the root
+    m_base = base.m_node;
+    m_stream_start = (base.m_stream_start >= 0 ? 0 : -1);
+  }
+  else {
+    m_base = base.m_base;
+    m_path = base.m_path;
+    m_stream_start = base.m_stream_start;
+  }
   m_path.push_back(node_info(keystr));
 }
 
 json::ref::ref(const ref & base, int index)
-: m_js(base.m_js), m_path(base.m_path)
+: m_js(base.m_js), m_base(base.m_base), m_path(base.m_path),
+  m_stream_start(base.m_stream_start)
 {
-  jassert(0 <= index && index < 10000); // Limit: large arrays not supported
+  // Array elements are not started at the array node because
+  // with_suffix() needs the key of the array
+  jassert(0 <= index);
   m_path.push_back(node_info(index));
 }
 
 json::ref::ref(const ref & base, const char * /*dummy*/, const char * key_suffix)
-: m_js(base.m_js), m_path(base.m_path)
+: m_js(base.m_js), m_base(base.m_base), m_path(base.m_path),
+  m_stream_start(base.m_stream_start)
 {
   int n = (int)m_path.size(), i;
   for (i = n; --i >= 0; ) {
@@ -115,19 +131,35 @@ json::ref::~ref()
 {
 }
 
+json::ref json::ref::stream() const
+{
+  ref r(*this);
+  if (m_js.m_streaming && m_stream_start < 0 && !m_path.empty())
+    r.m_stream_start = (int)m_path.size();
+  return r;
+}
+
+// Return node of this element if it already exists in the tree.
+json::node * json::ref::find_node() const
+{
+  if (!m_node)
+    m_node = find_path(m_base, m_path);
+  return m_node;
+}
+
 void json::ref::operator=(bool value)
 {
-  m_js.set_bool(m_path, value);
+  m_js.set_bool(*this, value);
 }
 
 void json::ref::operator=(long long value)
 {
-  m_js.set_int64(m_path, (int64_t)value);
+  m_js.set_int64(*this, (int64_t)value);
 }
 
 void json::ref::operator=(unsigned long long value)
 {
-  m_js.set_uint64(m_path, (uint64_t)value);
+  m_js.set_uint64(*this, (uint64_t)value);
 }
 
 void json::ref::operator=(int value)
@@ -152,12 +184,12 @@ void json::ref::operator=(unsigned long value)
 
 void json::ref::operator=(const char * value)
 {
-  m_js.set_cstring(m_path, value);
+  m_js.set_cstring(*this, value);
 }
 
 void json::ref::operator=(const std::string & value)
 {
-  m_js.set_string(m_path, value);
+  m_js.set_string(*this, value);
 }
 
 void json::ref::set_uint128(uint64_t value_hi, uint64_t value_lo)
@@ -165,7 +197,7 @@ void json::ref::set_uint128(uint64_t value_hi, uint64_t value_lo)
   if (!value_hi)
     operator=((unsigned long long)value_lo);
   else
-    m_js.set_uint128(m_path, value_hi, value_lo);
+    m_js.set_uint128(*this, value_hi, value_lo);
 }
 
 bool json::ref::set_if_safe_uint64(uint64_t value)
@@ -198,7 +230,7 @@ void json::ref::set_unsafe_uint64(uint64_t value)
 {
   // Output as number "KEY"
   operator=((unsigned long long)value);
-  if (!m_js.m_verbose && is_safe_uint(value))
+  if (m_js.m_native_ints || (!m_js.m_verbose && is_safe_uint(value)))
     return;
   // Output as string "KEY_s"
   char s[32];
@@ -208,7 +240,9 @@ void json::ref::set_unsafe_uint64(uint64_t value)
 
 void json::ref::set_unsafe_uint128(uint64_t value_hi, uint64_t value_lo)
 {
-  if (!m_js.m_verbose && !value_hi)
+  if (m_js.m_native_ints)
+    set_uint128(value_hi, value_lo);
+  else if (!m_js.m_verbose && !value_hi)
     set_unsafe_uint64(value_lo);
   else {
     // Output as number "KEY", string "KEY_s" and LE byte array "KEY_le[]"
@@ -262,6 +296,43 @@ void json::ref::operator+=(std::initializer_list<initlist_value> ilist)
     operator[](i++) = v;
 }
 
+// Renders the elements below a streamed node to JSON text in the order
+// they are written.  Only the containers on the path to the last written
+// value are kept open.
+class json::stream_writer
+{
+public:
+  stream_writer(bool pretty, int level)
+    : m_pretty(pretty), m_level(level) { }
+
+  bool write(const node_path & path, unsigned start, node_type type,
+             uint64_t intval, uint64_t intval_hi, const char * strval);
+
+  void print(out_buffer & out) const;
+
+private:
+  struct container
+  {
+    bool is_obj;
+    bool empty = true;
+    int next_index = 0; //< Array: index of next element
+    std::vector<std::string> keys; //< Object: keys of all elements, last is open
+
+    explicit container(bool is_obj_) : is_obj(is_obj_) { }
+  };
+
+  bool m_pretty;
+  int m_level;
+  std::string m_text;
+  std::vector<container> m_open; //< Open containers, outermost first
+
+  void open(bool is_obj);
+  void close();
+  unsigned open_depth(const node_info * rel, unsigned n) const;
+  bool can_begin_element(const node_info * rel, unsigned n) const;
+  void begin_element(const node_info & ni);
+};
+
 json::node::node()
 {
 }
@@ -275,6 +346,28 @@ json::node::~node()
 {
 }
 
+// Move scalar array elements to child nodes.
+void json::node::scalars_to_childs()
+{
+  const scalar_array & sa = *scalars;
+  childs.resize(sa.elements.size());
+  for (unsigned i = 0; i < sa.elements.size(); i++) {
+    const scalar_array::element & e = sa.elements[i];
+    if (e.type == nt_unset)
+      continue; // Unset element of sparse array
+    node * p = new node;
+    childs[i].reset(p);
+    p->depth = depth + 1;
+    p->type = e.type;
+    if (e.type == nt_string)
+      p->strval.assign(sa.strings, e.intval, e.intval_hi);
+    else {
+      p->intval = e.intval; p->intval_hi = e.intval_hi;
+    }
+  }
+  scalars.reset();
+}
+
 json::node::const_iterator::const_iterator(const json::node * node_p, bool sorted)
 : m_node_p(node_p),
   m_use_map(sorted && node_p->type == nt_object)
@@ -287,6 +380,8 @@ bool json::node::const_iterator::at_end() const
 {
   if (m_use_map)
     return (m_key_iter == m_node_p->key2index.end());
+  else if (m_node_p->scalars)
+    return (m_child_idx >= m_node_p->scalars->elements.size());
   else
     return (m_child_idx >= m_node_p->childs.size());
 }
@@ -309,14 +404,52 @@ const json::node * json::node::const_iterator::operator*() const
 {
   if (m_use_map)
     return m_node_p->childs[m_key_iter->second].get();
+  else if (m_node_p->scalars) {
+    // Return temporary node with copy of element
+    const scalar_array & sa = *m_node_p->scalars;
+    const scalar_array::element & e = sa.elements[m_child_idx];
+    if (e.type == nt_unset)
+      return nullptr; // Unset element of sparse array
+    if (!m_scalar_node)
+      m_scalar_node.reset(new node);
+    node * p = m_scalar_node.get();
+    p->type = e.type;
+    if (e.type == nt_string)
+      p->strval.assign(sa.strings, e.intval, e.intval_hi);
+    else {
+      p->intval = e.intval; p->intval_hi = e.intval_hi;
+    }
+    return p;
+  }
   else
     return m_node_p->childs[m_child_idx].get();
 }
 
-json::node * json::find_or_create_node(const json::node_path & path, node_type type)
+// Return node at PATH below BASE or nullptr if it does not exist.
+json::node * json::find_path(node * base, const json::node_path & path)
+{
+  node * p = base;
+  for (unsigned i = 0; i < path.size() && p; i++) {
+    const node_info & pi = path[i];
+    if (!pi.key.empty()) {
+      if (p->type != nt_object)
+        return nullptr;
+      node::keymap::const_iterator ni = p->key2index.find(pi.key);
+      p = (ni != p->key2index.end() ? p->childs[ni->second].get() : nullptr);
+    }
+    else {
+      if (!(p->type == nt_array && pi.index < (int)p->childs.size()))
+        return nullptr;
+      p = p->childs[pi.index].get();
+    }
+  }
+  return p;
+}
+
+json::node * json::find_or_create_path(node * base, const json::node_path & path, unsigned len)
 {
-  node * p = &m_root_node;
-  for (unsigned i = 0; i < path.size(); i++) {
+  node * p = base;
+  for (unsigned i = 0; i < len; i++) {
     const node_info & pi = path[i];
     if (!pi.key.empty()) {
       // Object
@@ -325,16 +458,17 @@ json::node * json::find_or_create_node(const json::node_path & path, node_type t
       else
         jassert(p->type == nt_object); // Limit: type change not supported
       // Existing or new object element?
-      node::keymap::iterator ni = p->key2index.find(pi.key);
+      node::keymap::iterator ni = p->key2index.lower_bound(pi.key);
       node * p2;
-      if (ni != p->key2index.end()) {
+      if (ni != p->key2index.end() && ni->first == pi.key) {
         // Object element exists
         p2 = p->childs[ni->second].get();
       }
       else {
         // Create new object element
-        p->key2index[pi.key] = (unsigned)p->childs.size();
+        p->key2index.insert(ni, node::keymap::value_type(pi.key, (unsigned)p->childs.size()));
         p->childs.push_back(std::unique_ptr<node>(p2 = new node(pi.key)));
+        p2->depth = p->depth + 1;
       }
       jassert(p2 && p2->key == pi.key);
       p = p2;
@@ -346,24 +480,37 @@ json::node * json::find_or_create_node(const json::node_path & path, node_type t
         p->type = nt_array;
       else
         jassert(p->type == nt_array); // Limit: type change not supported
+      if (p->scalars)
+        p->scalars_to_childs(); // Element is no longer a scalar
       node * p2;
       // Existing or new array element?
       if (pi.index < (int)p->childs.size()) {
         // Array index exists
         p2 = p->childs[pi.index].get();
-        if (!p2) // Already created ?
+        if (!p2) { // Already created ?
           p->childs[pi.index].reset(p2 = new node);
+          p2->depth = p->depth + 1;
+        }
       }
       else {
         // Grow array, fill gap, create new element
         p->childs.resize(pi.index + 1);
         p->childs[pi.index].reset(p2 = new node);
+        p2->depth = p->depth + 1;
       }
       jassert(p2 && p2->key.empty());
       p = p2;
     }
   }
+  return p;
+}
 
+json::node * json::find_or_create_node(const ref & r, node_type type)
+{
+  // Path is only replayed on first assignment
+  node * p = r.m_node;
+  if (!p)
+    r.m_node = p = find_or_create_path(r.m_base, r.m_path, (unsigned)r.m_path.size());
   if (   p->type == nt_unset
       || (   nt_int <= p->type && p->type <= nt_uint128
           && nt_int <=    type &&    type <= nt_uint128))
@@ -373,61 +520,117 @@ json::node * json::find_or_create_node(const json::node_path & path, node_type t
   return p;
 }
 
-void json::set_bool(const node_path & path, bool value)
+// Write value below a streamed node.  Return false if the node was
+// already created in the tree before streaming was enabled.
+// A value which cannot be streamed is dropped and recorded.
+bool json::set_streamed(const ref & r, node_type type, uint64_t intval,
+                        uint64_t intval_hi, const char * strval)
 {
-  if (!m_enabled)
-    return;
-  find_or_create_node(path, nt_bool)->intval = (value ? 1 : 0);
+  node * p = find_or_create_path(r.m_base, r.m_path, r.m_stream_start);
+  if (p->type == nt_unset) {
+    p->type = nt_stream;
+    p->stream.reset(new stream_writer(m_stream_pretty, p->depth));
+  }
+  else if (p->type != nt_stream)
+    return false;
+  if (!p->stream->write(r.m_path, (unsigned)r.m_stream_start, type, intval, intval_hi, strval)) {
+    if (!m_stream_dropped++) {
+      std::string path;
+      for (const node_info & ni : r.m_path)
+        path += (!ni.key.empty() ? "." + ni.key : strprintf("[%d]", ni.index));
+      m_stream_dropped_path = path;
+    }
+  }
+  return true;
 }
 
-void json::set_int64(const node_path & path, int64_t value)
+// Set scalar value of element R.
+void json::set_value(const ref & r, node_type type, uint64_t intval, uint64_t intval_hi,
+                     const char * strval)
 {
   if (!m_enabled)
     return;
-  find_or_create_node(path, nt_int)->intval = (uint64_t)value;
+  jassert(nt_bool <= type && type <= nt_string); // Limit: empty object or array not supported
+  jassert(type != nt_string || strval != nullptr); // Limit: nullptr not supported
+  if (r.m_stream_start >= 0 && set_streamed(r, type, intval, intval_hi, strval))
+    return;
+
+  unsigned n = r.m_path.size();
+  if (!r.m_node && n > 0 && r.m_path[n-1].key.empty()) {
+    // Array element, keep in contiguous storage while all elements are scalars
+    node * pa = find_or_create_path(r.m_base, r.m_path, n - 1);
+    if (pa->type == nt_unset)
+      pa->type = nt_array;
+    else
+      jassert(pa->type == nt_array); // Limit: type change not supported
+    if (pa->childs.empty()) {
+      if (!pa->scalars)
+        pa->scalars.reset(new scalar_array);
+      scalar_array & sa = *pa->scalars;
+      unsigned index = r.m_path[n-1].index;
+      if (index >= sa.elements.size())
+        sa.elements.resize(index + 1);
+      scalar_array::element & e = sa.elements[index];
+      if (   e.type == nt_unset
+          || (   nt_int <= e.type && e.type <= nt_uint128
+              && nt_int <=   type &&   type <= nt_uint128))
+        e.type = type;
+      else
+        jassert(e.type == type); // Limit: type change not supported
+      if (type == nt_string) {
+        // Old string of overwritten element is not reused
+        e.intval = sa.strings.size();
+        e.intval_hi = strlen(strval);
+        sa.strings.append(strval, e.intval_hi);
+      }
+      else {
+        e.intval = intval; e.intval_hi = intval_hi;
+      }
+      return;
+    }
+  }
+
+  node * p = find_or_create_node(r, type);
+  if (type == nt_string)
+    p->strval = strval;
+  else {
+    p->intval = intval; p->intval_hi = intval_hi;
+  }
 }
 
-void json::set_uint64(const node_path & path, uint64_t value)
+void json::set_bool(const ref & r, bool value)
 {
-  if (!m_enabled)
-    return;
-  find_or_create_node(path, nt_uint)->intval = value;
+  set_value(r, nt_bool, (value ? 1 : 0));
 }
 
-void json::set_uint128(const node_path & path, uint64_t value_hi, uint64_t value_lo)
+void json::set_int64(const ref & r, int64_t value)
 {
-  if (!m_enabled)
-    return;
-  node * p = find_or_create_node(path, nt_uint128);
-  p->intval_hi = value_hi;
-  p->intval = value_lo;
+  set_value(r, nt_int, (uint64_t)value);
 }
 
-void json::set_cstring(const node_path & path, const char * value)
+void json::set_uint64(const ref & r, uint64_t value)
 {
-  if (!m_enabled)
-    return;
-  jassert(value != nullptr); // Limit: nullptr not supported
-  find_or_create_node(path, nt_string)->strval = value;
+  set_value(r, nt_uint, value);
 }
 
-void json::set_string(const node_path & path, const std::string & value)
+void json::set_uint128(const ref & r, uint64_t value_hi, uint64_t value_lo)
 {
-  if (!m_enabled)
-    return;
-  find_or_create_node(path, nt_string)->strval = value;
+  set_value(r, nt_uint128, value_lo, value_hi);
 }
 
-void json::set_initlist_value(const node_path & path, const initlist_value & val)
+void json::set_cstring(const ref & r, const char * value)
 {
-  if (!m_enabled)
-    return;
-  node * p = find_or_create_node(path, val.type);
-  switch (p->type) {
-    case nt_bool: case nt_int: case nt_uint: p->intval = val.intval; break;
-    case nt_string: p->strval = val.strval; break;
-    default: jassert(false);
-  }
+  set_value(r, nt_string, 0, 0, value);
+}
+
+void json::set_string(const ref & r, const std::string & value)
+{
+  set_value(r, nt_string, 0, 0, value.c_str());
+}
+
+void json::set_initlist_value(const ref & r, const initlist_value & val)
+{
+  set_value(r, val.type, val.intval, 0, val.strval);
 }
 
 // Return -1 if all UTF-8 sequences are valid, else return index of first invalid char
@@ -461,28 +664,194 @@ static int check_utf8(const char * s)
   return -1;
 }
 
-static void print_quoted_string(FILE * f, const char * s)
+// Output buffer for the print functions.  Output is collected in a
+// large buffer and written in blocks to avoid per char stdio calls.
+class json::out_buffer
+{
+public:
+  explicit out_buffer(FILE * f)
+    : m_f(f) { }
+
+  ~out_buffer()
+    { flush(); }
+
+  void put(char c)
+    {
+      if (m_len >= sizeof(m_buf))
+        flush();
+      m_buf[m_len++] = c;
+    }
+
+  void put(const char * s, size_t n);
+
+  void put(const char * s)
+    { put(s, strlen(s)); }
+
+  void put(const std::string & s)
+    { put(s.data(), s.size()); }
+
+  void put_spaces(int n);
+  void put_int(int64_t value);
+  void put_uint(uint64_t value);
+  void flush();
+
+private:
+  FILE * m_f;
+  size_t m_len = 0;
+  char m_buf[64 * 1024];
+};
+
+void json::out_buffer::put(const char * s, size_t n)
+{
+  if (n > sizeof(m_buf) - m_len) {
+    flush();
+    if (n > sizeof(m_buf)) {
+      fwrite(s, 1, n, m_f);
+      return;
+    }
+  }
+  memcpy(m_buf + m_len, s, n);
+  m_len += n;
+}
+
+void json::out_buffer::put_spaces(int n)
 {
+  static const char spaces[] = "                                ";
+  for (; n > 0; n -= (int)sizeof(spaces) - 1)
+    put(spaces, (n < (int)sizeof(spaces) - 1 ? n : (int)sizeof(spaces) - 1));
+}
+
+void json::out_buffer::flush()
+{
+  if (m_len > 0)
+    fwrite(m_buf, 1, m_len, m_f);
+  m_len = 0;
+}
+
+// Output to std::string, same interface as out_buffer.
+struct string_out
+{
+  std::string & str;
+
+  void put(char c)
+    { str += c; }
+  void put(const char * s, size_t n)
+    { str.append(s, n); }
+};
+
+// Format VALUE as decimal number ending at END, return start.
+static char * format_uint(char * end, uint64_t value)
+{
+  static const char digits[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  char * p = end;
+  // Two digits per division
+  while (value >= 100) {
+    unsigned i = (unsigned)(value % 100) * 2;
+    value /= 100;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  if (value >= 10) {
+    unsigned i = (unsigned)value * 2;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  else
+    *--p = (char)('0' + value);
+  return p;
+}
+
+// Format signed VALUE as decimal number ending at END, return start.
+static char * format_int(char * end, int64_t value)
+{
+  if (value >= 0)
+    return format_uint(end, (uint64_t)value);
+  char * p = format_uint(end, 0 - (uint64_t)value);
+  *--p = '-';
+  return p;
+}
+
+void json::out_buffer::put_int(int64_t value)
+{
+  char buf[24];
+  char * p = format_int(buf + sizeof(buf), value);
+  put(p, buf + sizeof(buf) - p);
+}
+
+void json::out_buffer::put_uint(uint64_t value)
+{
+  char buf[24];
+  char * p = format_uint(buf + sizeof(buf), value);
+  put(p, buf + sizeof(buf) - p);
+}
+
+// Return true if any of the 8 chars in X is not printable ASCII or is '"' or '\\'.
+static inline bool word_has_special_char(uint64_t x)
+{
+  const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+  uint64_t q = x ^ (ones * '"'), b = x ^ (ones * '\\'), d = x ^ (ones * 0x7f);
+  // Any byte < 0x20, == '"', == '\\', == 0x7f or >= 0x80
+  return !!((  ((x - ones * 0x20) & ~x)
+             | ((q - ones) & ~q) | ((b - ones) & ~b) | ((d - ones) & ~d)
+             | x                                                        ) & highs);
+}
+
+// Return true if C needs special handling in put_quoted_string().
+static inline bool is_special_char(char c)
+{
+  return !(' ' <= c && c <= '~' && c != '"' && c != '\\');
+}
+
+template <class Out>
+static void put_quoted_string(Out & out, const char * s)
+{
+  size_t len = strlen(s);
   int utf8_rc = -2;
-  putc('"', f);
-  for (int i = 0; s[i]; i++) {
+  out.put('"');
+  size_t start = 0; // Start of chars not yet output
+  for (size_t i = 0; i < len; ) {
+    if (i + 8 <= len) {
+      // Skip 8 plain chars at once
+      uint64_t x;
+      memcpy(&x, s + i, sizeof(x));
+      if (!word_has_special_char(x)) {
+        i += 8;
+        continue;
+      }
+    }
     char c = s[i];
+    if (!is_special_char(c)) {
+      i++;
+      continue;
+    }
+    out.put(s + start, i - start);
+    start = ++i;
+
     if (c == '"' || c == '\\')
-      putc('\\', f);
+      out.put('\\');
     else if (c == '\t') {
-      putc('\\', f); c = 't';
+      out.put('\\'); c = 't';
     }
     // Print as UTF-8 unless the string contains any invalid sequences
     // "\uXXXX" is not used because it is not valid for YAML
     if (   (' ' <= c && c <= '~')
-        || ((c & 0x80) && (utf8_rc >= -1 ? utf8_rc : (utf8_rc = check_utf8(s + i))) == -1))
-      putc(c, f);
-    else
+        || ((c & 0x80) && (utf8_rc >= -1 ? utf8_rc : (utf8_rc = check_utf8(s + i - 1))) == -1))
+      out.put(c);
+    else {
       // Print informal hex string for unexpected chars:
       // Control chars (except TAB), DEL(0x7f), bit 7 set and no valid UTF-8
-      fprintf(f, "\\\\x%02x", (unsigned char)c);
+      static const char hex[] = "0123456789abcdef";
+      char buf[] = { '\\', '\\', 'x', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+      out.put(buf, sizeof(buf));
+    }
   }
-  putc('"', f);
+  out.put(s + start, len - start);
+  out.put('"');
 }
 
 static char yaml_string_needs_quotes(const char * s)
@@ -509,165 +878,336 @@ static char yaml_string_needs_quotes(const char * s)
   if (need)
     return quotes;
 
+  // All special tokens start with one of these chars
+  if (!strchr("0123456789FfTtNnYy", s[0]))
+    return 0;
   static const regular_expression special(
     "[0-9]+[,0-9]*(\\.[0-9]*)?([eE][-+]?[0-9]+)?|" // decimal ('^[-+.]' handled above)
     "0x[0-7A-Fa-f]+|" // hex
     "[Ff][Aa][Ll][Ss][Ee]|[Tt][Rr][Uu][Ee]|[Nn][Oo]|[Yy][Ee][Ss]|" // boolean
     "[Nn][Uu][Ll][Ll]" // null
   );
+
   if (special.full_match(s))
     return quotes; // special token
   return 0; // none of the above
 }
 
-void json::print_json(FILE * f, bool pretty, bool sorted, const node * p, int level)
+void json::stream_writer::open(bool is_obj)
+{
+  m_text += (is_obj ? '{' : '[');
+  m_open.push_back(container(is_obj));
+}
+
+void json::stream_writer::close()
+{
+  if (m_pretty) {
+    m_text += '\n';
+    m_text.append((m_level + m_open.size() - 1) * 2, ' ');
+  }
+  m_text += (m_open.back().is_obj ? '}' : ']');
+  m_open.pop_back();
+}
+
+void json::stream_writer::begin_element(const node_info & ni)
+{
+  container & c = m_open.back();
+  jassert(c.is_obj == !ni.key.empty()); // Limit: type change not supported
+  int spaces = (m_level + (int)m_open.size()) * 2;
+  if (!c.is_obj) {
+    jassert(ni.index >= c.next_index); // Limit: streamed element already written
+    // Fill gap of sparse array
+    for (; c.next_index <= ni.index; c.next_index++) {
+      if (!c.empty)
+        m_text += ',';
+      if (m_pretty) {
+        m_text += '\n';
+        m_text.append(spaces, ' ');
+      }
+      if (c.next_index < ni.index)
+        m_text += "null";
+      c.empty = false;
+    }
+  }
+  else {
+    jassert(std::find(c.keys.begin(), c.keys.end(), ni.key) == c.keys.end()); // Limit: streamed element already written
+    c.keys.push_back(ni.key);
+    if (!c.empty)
+      m_text += ',';
+    if (m_pretty) {
+      m_text += '\n';
+      m_text.append(spaces, ' ');
+    }
+    m_text += '"'; m_text += ni.key; m_text += (m_pretty ? "\": " : "\":");
+    c.empty = false;
+  }
+}
+
+// Return depth of the last open container which is on the path REL[0..N).
+unsigned json::stream_writer::open_depth(const node_info * rel, unsigned n) const
+{
+  unsigned d = 0;
+  for (; d + 1 < n && d + 1 < m_open.size(); d++) {
+    const container & c = m_open[d];
+    if (c.is_obj != !rel[d].key.empty())
+      break;
+    if (c.is_obj ? rel[d].key != c.keys.back() : rel[d].index != c.next_index - 1)
+      break;
+  }
+  return d;
+}
+
+// Return true if the element REL[0..N) can still be appended to the text.
+bool json::stream_writer::can_begin_element(const node_info * rel, unsigned n) const
+{
+  if (!n)
+    return false; // Streamed element itself must be an object or array
+  if (m_open.empty())
+    return true;
+  unsigned d = open_depth(rel, n);
+  const container & c = m_open[d];
+  if (c.is_obj != !rel[d].key.empty())
+    return false; // Type change
+  if (!c.is_obj)
+    return (rel[d].index >= c.next_index);
+  return (std::find(c.keys.begin(), c.keys.end(), rel[d].key) == c.keys.end());
+}
+
+// Append element to the text.  Return false if the element was already
+// written or its type changed, the text is then unchanged.
+bool json::stream_writer::write(const node_path & path, unsigned start, node_type type,
+                                uint64_t intval, uint64_t intval_hi, const char * strval)
+{
+  unsigned n = path.size() - start;
+  const node_info * rel = path.data() + start;
+  if (!can_begin_element(rel, n))
+    return false;
+  if (m_open.empty())
+    open(!rel[0].key.empty());
+
+  // Keep containers open as long as they are on the path
+  unsigned d = open_depth(rel, n);
+  while (m_open.size() > d + 1)
+    close();
+
+  // Add new element and its new parents
+  begin_element(rel[d]);
+  for (unsigned i = d + 1; i < n; i++) {
+    open(!rel[i].key.empty());
+    begin_element(rel[i]);
+  }
+
+  char buf[64];
+  switch (type) {
+    case nt_bool:
+      m_text += (intval ? "true" : "false");
+      break;
+    case nt_int:
+      m_text.append(format_int(buf + sizeof(buf), (int64_t)intval), buf + sizeof(buf));
+      break;
+    case nt_uint:
+      m_text.append(format_uint(buf + sizeof(buf), intval), buf + sizeof(buf));
+      break;
+    case nt_uint128:
+      m_text += uint128_hilo_to_str(buf, intval_hi, intval);
+      break;
+    case nt_string: {
+        string_out out{m_text};
+        put_quoted_string(out, strval);
+      }
+      break;
+    default: jassert(false);
+  }
+  return true;
+}
+
+void json::stream_writer::print(out_buffer & out) const
+{
+  out.put(m_text);
+  // Close containers which are still open
+  for (unsigned i = m_open.size(); i-- > 0; ) {
+    if (m_pretty) {
+      out.put('\n');
+      out.put_spaces((m_level + (int)i) * 2);
+    }
+    out.put((m_open[i].is_obj ? '}' : ']'));
+  }
+}
+
+void json::print_json(out_buffer & out, bool pretty, bool sorted, const node * p, int level)
 {
   bool is_obj = (p->type == nt_object);
   switch (p->type) {
     case nt_object:
     case nt_array:
-      putc((is_obj ? '{' : '['), f);
-      if (!p->childs.empty()) {
+      out.put((is_obj ? '{' : '['));
+      if (!p->empty()) {
         bool first = true;
         for (node::const_iterator it(p, sorted); !it.at_end(); ++it) {
           if (!first)
-            putc(',', f);
-          if (pretty)
-            fprintf(f, "\n%*s", (level + 1) * 2, "");
+            out.put(',');
+          if (pretty) {
+            out.put('\n');
+            out.put_spaces((level + 1) * 2);
+          }
           const node * p2 = *it;
           if (!p2) {
             // Unset element of sparse array
             jassert(!is_obj);
-            fputs("null", f);
+            out.put("null", 4);
           }
           else {
             jassert(is_obj == !p2->key.empty());
-            if (is_obj)
-              fprintf(f, "\"%s\":%s", p2->key.c_str(), (pretty ? " " : ""));
+            if (is_obj) {
+              out.put('"'); out.put(p2->key);
+              out.put((pretty ? "\": " : "\":"));
+            }
             // Recurse
-            print_json(f, pretty, sorted, p2, level + 1);
+            print_json(out, pretty, sorted, p2, level + 1);
           }
           first = false;
         }
-        if (pretty)
-          fprintf(f, "\n%*s", level * 2, "");
+        if (pretty) {
+          out.put('\n');
+          out.put_spaces(level * 2);
+        }
       }
-      putc((is_obj ? '}' : ']'), f);
+      out.put((is_obj ? '}' : ']'));
       break;
 
     case nt_bool:
-      fputs((p->intval ? "true" : "false"), f);
+      out.put((p->intval ? "true" : "false"));
       break;
 
     case nt_int:
-      fprintf(f, "%" PRId64, (int64_t)p->intval);
+      out.put_int((int64_t)p->intval);
       break;
 
     case nt_uint:
-      fprintf(f, "%" PRIu64, p->intval);
+      out.put_uint(p->intval);
       break;
 
     case nt_uint128:
       {
         char buf[64];
-        fputs(uint128_hilo_to_str(buf, p->intval_hi, p->intval), f);
+        out.put(uint128_hilo_to_str(buf, p->intval_hi, p->intval));
       }
       break;
 
     case nt_string:
-      print_quoted_string(f, p->strval.c_str());
+      put_quoted_string(out, p->strval.c_str());
+      break;
+
+    case nt_stream:
+      jassert(!sorted); // Limit: streamed elements are not sorted
+      p->stream->print(out);
       break;
 
     default: jassert(false);
   }
 }
 
-void json::print_yaml(FILE * f, bool pretty, bool sorted, const node * p, int level_o,
+void json::print_yaml(out_buffer & out, bool pretty, bool sorted, const node * p, int level_o,
                       int level_a, bool cont)
 {
   bool is_obj = (p->type == nt_object);
   switch (p->type) {
     case nt_object:
     case nt_array:
-      if (!p->childs.empty()) {
+      if (!p->empty()) {
         if (!cont)
-          fputs("\n", f);
+          out.put('\n');
         for (node::const_iterator it(p, sorted); !it.at_end(); ++it) {
           int spaces = (cont ? 1 : (is_obj ? level_o : level_a) * 2);
-          if (spaces > 0)
-            fprintf(f, "%*s", spaces, "");
+          out.put_spaces(spaces);
           const node * p2 = *it;
           if (!p2) {
             // Unset element of sparse array
             jassert(!is_obj);
-            fputs("-" /*" null"*/ "\n", f);
+            out.put("-" /*" null"*/ "\n");
           }
           else {
             jassert(is_obj == !p2->key.empty());
-            if (is_obj)
-              fprintf(f, "%s:", p2->key.c_str());
+            if (is_obj) {
+              out.put(p2->key); out.put(':');
+            }
             else
-              putc('-', f);
+              out.put('-');
             // Recurse
-            print_yaml(f, pretty, sorted, p2, (is_obj ? level_o : level_a) + 1,
+            print_yaml(out, pretty, sorted, p2, (is_obj ? level_o : level_a) + 1,
                        (is_obj ? level_o + (pretty ? 1 : 0) : level_a + 1), !is_obj);
           }
           cont = false;
         }
       }
       else {
-        fputs((is_obj ? "{}\n" : "[]\n"), f);
+        out.put((is_obj ? "{}\n" : "[]\n"));
       }
       break;
 
     case nt_bool:
-      fputs((p->intval ? " true\n" : " false\n"), f);
+      out.put((p->intval ? " true\n" : " false\n"));
       break;
 
     case nt_int:
-      fprintf(f, " %" PRId64 "\n", (int64_t)p->intval);
+      out.put(' ');
+      out.put_int((int64_t)p->intval);
+      out.put('\n');
       break;
 
     case nt_uint:
-      fprintf(f, " %" PRIu64 "\n", p->intval);
+      out.put(' ');
+      out.put_uint(p->intval);
+      out.put('\n');
       break;
 
     case nt_uint128:
       {
         char buf[64];
-        fprintf(f, " %s\n", uint128_hilo_to_str(buf, p->intval_hi, p->intval));
+        out.put(' ');
+        out.put(uint128_hilo_to_str(buf, p->intval_hi, p->intval));
+        out.put('\n');
       }
       break;
 
     case nt_string:
-      putc(' ', f);
+      out.put(' ');
       switch (yaml_string_needs_quotes(p->strval.c_str())) {
-        default:   print_quoted_string(f, p->strval.c_str()); break;
-        case '\'': fprintf(f, "'%s'", p->strval.c_str()); break;
-        case 0:    fputs(p->strval.c_str(), f); break;
+        default:   put_quoted_string(out, p->strval.c_str()); break;
+        case '\'': out.put('\''); out.put(p->strval); out.put('\''); break;
+        case 0:    out.put(p->strval); break;
       }
-      putc('\n', f);
+      out.put('\n');
       break;
 
     default: jassert(false);
   }
 }
 
-void json::print_flat(FILE * f, const char * assign, bool sorted, const node * p,
+void json::print_flat(out_buffer & out, const char * assign, bool sorted, const node * p,
                       std::string & path)
 {
   bool is_obj = (p->type == nt_object);
+  if (p->type != nt_object && p->type != nt_array) {
+    out.put(path);
+    out.put(assign);
+  }
   switch (p->type) {
     case nt_object:
     case nt_array:
-      fprintf(f, "%s%s%s;\n", path.c_str(), assign, (is_obj ? "{}" : "[]"));
-      if (!p->childs.empty()) {
+      out.put(path); out.put(assign);
+      out.put((is_obj ? "{};\n" : "[];\n"));
+      if (!p->empty()) {
         unsigned len = path.size();
         for (node::const_iterator it(p, sorted); !it.at_end(); ++it) {
           const node * p2 = *it;
           if (!is_obj) {
-            char buf[10]; snprintf(buf, sizeof(buf), "[%u]", it.array_index());
-            path += buf;
+            char buf[24];
+            char * end = buf + sizeof(buf);
+            *--end = ']';
+            char * start = format_uint(end, it.array_index());
+            *--start = '[';
+            path.append(start, end + 1 - start);
           }
           else {
             path += '.'; path += p2->key;
@@ -675,11 +1215,11 @@ void json::print_flat(FILE * f, const char * assign, bool sorted, const node * p
           if (!p2) {
             // Unset element of sparse array
             jassert(!is_obj);
-            fprintf(f, "%s%snull;\n", path.c_str(), assign);
+            out.put(path); out.put(assign); out.put("null;\n");
           }
           else {
             // Recurse
-            print_flat(f, assign, sorted, p2, path);
+            print_flat(out, assign, sorted, p2, path);
           }
           path.erase(len);
         }
@@ -687,33 +1227,155 @@ void json::print_flat(FILE * f, const char * assign, bool sorted, const node * p
       break;
 
     case nt_bool:
-      fprintf(f, "%s%s%s;\n", path.c_str(), assign, (p->intval ? "true" : "false"));
+      out.put((p->intval ? "true" : "false"));
       break;
 
     case nt_int:
-      fprintf(f, "%s%s%" PRId64 ";\n", path.c_str(), assign, (int64_t)p->intval);
+      out.put_int((int64_t)p->intval);
       break;
 
     case nt_uint:
-      fprintf(f, "%s%s%" PRIu64 ";\n", path.c_str(), assign, p->intval);
+      out.put_uint(p->intval);
       break;
 
     case nt_uint128:
       {
         char buf[64];
-        fprintf(f, "%s%s%s;\n", path.c_str(), assign,
-                uint128_hilo_to_str(buf, p->intval_hi, p->intval));
+        out.put(uint128_hilo_to_str(buf, p->intval_hi, p->intval));
       }
       break;
 
     case nt_string:
-      fprintf(f, "%s%s", path.c_str(), assign);
-      print_quoted_string(f, p->strval.c_str());
-      fputs(";\n", f);
+      put_quoted_string(out, p->strval.c_str());
       break;
 
     default: jassert(false);
   }
+  if (p->type != nt_object && p->type != nt_array)
+    out.put(";\n", 2);
+}
+
+// Write CBOR data item head with major type MAJOR and argument VAL.
+template <class Out>
+static void put_cbor_head(Out & out, int major, uint64_t val)
+{
+  unsigned char buf[9];
+  int n;
+  if (val < 24) {
+    buf[0] = (unsigned char)((major << 5) | val); n = 1;
+  }
+  else if (val <= 0xff) {
+    buf[0] = (unsigned char)((major << 5) | 24); buf[1] = (unsigned char)val; n = 2;
+  }
+  else if (val <= 0xffff) {
+    buf[0] = (unsigned char)((major << 5) | 25); sg_put_unaligned_be16((uint16_t)val, buf + 1); n = 3;
+  }
+  else if (val <= 0xffffffff) {
+    buf[0] = (unsigned char)((major << 5) | 26); sg_put_unaligned_be32((uint32_t)val, buf + 1); n = 5;
+  }
+  else {
+    buf[0] = (unsigned char)((major << 5) | 27); sg_put_unaligned_be64(val, buf + 1); n = 9;
+  }
+  out.put((const char *)buf, n);
+}
+
+// Write CBOR text string.  Chars which are not valid UTF-8 are replaced
+// by the same informal hex string as in JSON output.
+template <class Out>
+static void put_cbor_string(Out & out, const char * s)
+{
+  std::string str;
+  int utf8_rc = -2;
+  for (int i = 0; s[i]; i++) {
+    char c = s[i];
+    if (   (' ' <= c && c <= '~') || c == '\t'
+        || ((c & 0x80) && (utf8_rc >= -1 ? utf8_rc : (utf8_rc = check_utf8(s + i))) == -1))
+      str += c;
+    else {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\x%02x", (unsigned char)c);
+      str += buf;
+    }
+  }
+  put_cbor_head(out, 3, str.size());
+  out.put(str);
+}
+
+void json::print_cbor(out_buffer & out, bool sorted, const node * p)
+{
+  bool is_obj = (p->type == nt_object);
+  switch (p->type) {
+    case nt_object:
+    case nt_array:
+      put_cbor_head(out, (is_obj ? 5 : 4),
+                    (p->scalars ? p->scalars->elements.size() : p->childs.size()));
+      for (node::const_iterator it(p, sorted); !it.at_end(); ++it) {
+        const node * p2 = *it;
+        if (!p2) {
+          // Unset element of sparse array
+          jassert(!is_obj);
+          out.put((char)0xf6); // null
+        }
+        else {
+          jassert(is_obj == !p2->key.empty());
+          if (is_obj)
+            put_cbor_string(out, p2->key.c_str());
+          // Recurse
+          print_cbor(out, sorted, p2);
+        }
+      }
+      break;
+
+    case nt_bool:
+      out.put((char)(p->intval ? 0xf5 : 0xf4));
+      break;
+
+    case nt_int:
+      if ((int64_t)p->intval < 0)
+        put_cbor_head(out, 1, ~p->intval); // -1 - value
+      else
+        put_cbor_head(out, 0, p->intval);
+      break;
+
+    case nt_uint:
+      put_cbor_head(out, 0, p->intval);
+      break;
+
+    case nt_uint128:
+      if (!p->intval_hi)
+        put_cbor_head(out, 0, p->intval);
+      else {
+        // Tag 2: unsigned bignum, big endian byte string
+        unsigned char buf[16];
+        sg_put_unaligned_be64(p->intval_hi, buf);
+        sg_put_unaligned_be64(p->intval, buf + 8);
+        int i = 0;
+        while (!buf[i])
+          i++;
+        out.put((char)0xc2);
+        put_cbor_head(out, 2, sizeof(buf) - i);
+        out.put((const char *)buf + i, sizeof(buf) - i);
+      }
+      break;
+
+    case nt_string:
+      put_cbor_string(out, p->strval.c_str());
+      break;
+
+    default: jassert(false);
+  }
+}
+
+void json::clear()
+{
+  m_root_node.type = nt_unset;
+  m_root_node.childs.clear();
+  m_root_node.key2index.clear();
+  m_root_node.stream.reset();
+  m_root_node.scalars.reset();
+  m_uint128_output = false;
+  m_stream_dropped = 0;
+  m_stream_dropped_path.clear();
 }
 
 void json::print(FILE * f, const print_options & options) const
@@ -721,22 +1383,30 @@ void json::print(FILE * f, const print_options & options) const
   if (m_root_node.type == nt_unset)
     return;
   jassert(m_root_node.type == nt_object);
+  // Limit: streamed elements are rendered as JSON with options from enable_streaming()
+  jassert(!m_streaming || (   options.format != 'y' && options.format != 'g'
+                           && options.format != 'b'
+                           && !options.sorted && options.pretty == m_stream_pretty));
 
+  out_buffer out(f);
   switch (options.format) {
     default:
-      print_json(f, options.pretty, options.sorted, &m_root_node, 0);
+      print_json(out, options.pretty, options.sorted, &m_root_node, 0);
       if (options.pretty)
-        putc('\n', f);
+        out.put('\n');
       break;
     case 'y':
-      fputs("---", f);
-      print_yaml(f, options.pretty, options.sorted, &m_root_node, 0, 0, false);
+      out.put("---", 3);
+      print_yaml(out, options.pretty, options.sorted, &m_root_node, 0, 0, false);
       break;
     case 'g': {
         std::string path("json");
-        print_flat(f, (options.pretty ? " = " : "="), options.sorted, &m_root_node, path);
+        print_flat(out, (options.pretty ? " = " : "="), options.sorted, &m_root_node, path);
       }
       break;
+    case 'b':
+      print_cbor(out, options.sorted, &m_root_node);
+      break;
   }
 }
 
@@ -22,8 +22,13 @@
 #ifdef _WIN32
 #include <io.h> // access()
 #endif
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <ctype.h>
+#include <map>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace smartmon {
 
@@ -45,6 +50,296 @@ const drive_settings builtin_knowndrives[] = {
 const unsigned builtin_knowndrives_size =
   sizeof(builtin_knowndrives) / sizeof(builtin_knowndrives[0]);
 
+// Return pointer behind ']' of bracket expression at P.
+static const char * skip_bracket(const char * p, const char * end)
+{
+  p++;
+  if (p < end && *p == '^')
+    p++;
+  if (p < end && *p == ']')
+    p++;
+  while (p < end && *p != ']') {
+    if (*p == '[' && p + 1 < end && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+      // "[:class:]", "[.coll.]", "[=equiv=]"
+      char c = p[1];
+      for (p += 2; p + 1 < end && !(p[0] == c && p[1] == ']'); p++) ;
+      p++;
+    }
+    p++;
+  }
+  return (p < end ? p + 1 : end);
+}
+
+// Return pointer behind ')' of group at P.
+static const char * skip_group(const char * p, const char * end)
+{
+  int depth = 0;
+  while (p < end) {
+    switch (*p) {
+      case '\\': p += 2; continue;
+      case '[':  p = skip_bracket(p, end); continue;
+      case '(':  depth++; break;
+      case ')':
+        if (--depth == 0)
+          return p + 1;
+        break;
+    }
+    p++;
+  }
+  return end;
+}
+
+// Split regular expression [P, END) into top level alternatives.
+static void split_alternatives(const char * p, const char * end,
+  std::vector< std::pair<const char *, const char *> > & alts)
+{
+  const char * start = p;
+  while (p < end) {
+    switch (*p) {
+      case '\\': p += 2; continue;
+      case '[':  p = skip_bracket(p, end); continue;
+      case '(':  p = skip_group(p, end); continue;
+      case '|':
+        alts.push_back({start, p});
+        start = p + 1;
+        break;
+    }
+    p++;
+  }
+  alts.push_back({start, end});
+}
+
+// Return the longest literal string which occurs in each match of the
+// regular expression [P, END) without top level alternatives.
+static std::string get_required_literal(const char * p, const char * end)
+{
+  std::string best, run;
+  while (p < end) {
+    // Get next atom
+    const char * q; int lit = -1; std::string sub;
+    if (*p == '\\') {
+      q = std::min(p + 2, end);
+      if (q == p + 2 && !isalnum((unsigned char)p[1]))
+        lit = (unsigned char)p[1];
+    }
+    else if (*p == '[')
+      q = skip_bracket(p, end);
+    else if (*p == '(') {
+      q = skip_group(p, end);
+      std::vector< std::pair<const char *, const char *> > alts;
+      split_alternatives(p + 1, q - 1, alts);
+      if (alts.size() == 1)
+        sub = get_required_literal(p + 1, q - 1);
+    }
+    else {
+      q = p + 1;
+      if (!strchr(".^$|)*+?{", *p))
+        lit = (unsigned char)*p;
+    }
+
+    // Check for quantifier, only '+' keeps the atom required
+    char quant = (q < end ? *q : 0);
+    if (quant == '{') {
+      for (q++; q < end && *q != '}'; q++) ;
+      q = std::min(q + 1, end);
+    }
+    else if (quant == '*' || quant == '+' || quant == '?')
+      q++;
+    else
+      quant = 0;
+
+    if (lit >= 0 && (!quant || quant == '+'))
+      run += (char)lit;
+    if (lit < 0 || quant) {
+      // End of literal run
+      if (best.size() < run.size())
+        best = run;
+      run.clear();
+    }
+    if ((!quant || quant == '+') && best.size() < sub.size())
+      best = sub;
+    p = q;
+  }
+  if (best.size() < run.size())
+    best = run;
+  return best;
+}
+
+// Get required literals of regular expression PATTERN, one for each
+// alternative.  An empty string is returned if any alternative has none.
+static void get_required_literals(const char * pattern, std::vector<std::string> & literals)
+{
+  std::vector< std::pair<const char *, const char *> > alts;
+  split_alternatives(pattern, pattern + strlen(pattern), alts);
+  for (unsigned i = 0; i < alts.size(); i++) {
+    const char * p = alts[i].first, * end = alts[i].second;
+    if (p < end && *p == '(' && skip_group(p, end) == end) {
+      // "(ALT1|ALT2)", check alternatives of group
+      std::string inner(p + 1, end - 1);
+      get_required_literals(inner.c_str(), literals);
+      if (literals.size() == 1 && literals[0].empty())
+        return;
+      continue;
+    }
+    std::string lit = get_required_literal(p, end);
+    if (lit.empty()) {
+      literals.assign(1, lit);
+      return;
+    }
+    literals.push_back(lit);
+  }
+}
+
+// Expand regular expression [P, END) to the set of all strings it matches.
+// Only literals, bracket expressions with chars and ranges, and groups with
+// alternatives are supported.  Return false if unsupported or if the
+// set would have more than LIMIT strings.
+static bool expand_regex(const char * p, const char * end,
+  std::vector<std::string> & strs, unsigned limit)
+{
+  std::vector< std::pair<const char *, const char *> > alts;
+  split_alternatives(p, end, alts);
+  for (unsigned i = 0; i < alts.size(); i++) {
+    std::vector<std::string> seq(1), atom;
+    for (const char * q = alts[i].first; q < alts[i].second; ) {
+      // Get set of strings matched by next atom
+      const char * qe;
+      atom.clear();
+      if (*q == '(') {
+        qe = skip_group(q, alts[i].second);
+        if (!expand_regex(q + 1, qe - 1, atom, limit))
+          return false;
+      }
+      else if (*q == '[') {
+        qe = skip_bracket(q, alts[i].second);
+        if (q[1] == '^' || q[1] == ']')
+          return false;
+        for (const char * b = q + 1; b < qe - 1; b++) {
+          if (*b == '[')
+            return false; // "[:class:]", ...
+          char c1 = *b, c2 = c1;
+          if (b + 2 < qe - 1 && b[1] == '-')
+            c2 = b[2], b += 2;
+          for (int c = (unsigned char)c1; c <= (unsigned char)c2; c++)
+            atom.push_back(std::string(1, (char)c));
+        }
+      }
+      else if (*q == '\\') {
+        qe = q + 2;
+        if (!(qe <= alts[i].second && !isalnum((unsigned char)q[1])))
+          return false;
+        atom.push_back(std::string(1, q[1]));
+      }
+      else {
+        qe = q + 1;
+        if (strchr(".^$*+?{", *q))
+          return false;
+        atom.push_back(std::string(1, *q));
+      }
+      if (qe < alts[i].second && strchr("*+?{", *qe))
+        return false; // Quantifier
+      if (seq.size() * atom.size() > limit)
+        return false;
+
+      // Append each string of atom to each string of sequence
+      std::vector<std::string> next;
+      for (const std::string & s1 : seq)
+        for (const std::string & s2 : atom)
+          next.push_back(s1 + s2);
+      seq.swap(next);
+      q = qe;
+    }
+    if (strs.size() + seq.size() > limit)
+      return false;
+    strs.insert(strs.end(), seq.begin(), seq.end());
+  }
+  return true;
+}
+
+/// Aho-Corasick automaton to find strings which contain any of a set of
+/// literals.  Each literal is associated with an entry index.
+class literal_index
+{
+public:
+  literal_index()
+    : m_nodes(1) { }
+
+  void clear()
+    { m_nodes.assign(1, node()); }
+
+  /// Add literal STR for entry index I.
+  void add(const std::string & str, unsigned i);
+
+  /// Set failure links, must be called after last add().
+  void build();
+
+  /// Append entry indexes of all literals which occur in STR.
+  void find(const char * str, std::vector<unsigned> & found) const;
+
+private:
+  struct node
+  {
+    std::map<char, unsigned> next;
+    unsigned fail = 0; //< Node of longest proper suffix
+    unsigned output = 0; //< Next node with entries on fail chain, 0 if none
+    std::vector<unsigned> entries;
+  };
+
+  std::vector<node> m_nodes; //< Root node is at index 0
+};
+
+void literal_index::add(const std::string & str, unsigned i)
+{
+  unsigned n = 0;
+  for (char c : str) {
+    std::map<char, unsigned>::const_iterator it = m_nodes[n].next.find(c);
+    if (it != m_nodes[n].next.end())
+      n = it->second;
+    else {
+      m_nodes.push_back(node());
+      m_nodes[n].next[c] = m_nodes.size() - 1;
+      n = m_nodes.size() - 1;
+    }
+  }
+  m_nodes[n].entries.push_back(i);
+}
+
+void literal_index::build()
+{
+  // Breadth first, fail links point to nodes of lower depth
+  std::vector<unsigned> queue;
+  for (const auto & cn : m_nodes[0].next)
+    queue.push_back(cn.second);
+  for (unsigned qi = 0; qi < queue.size(); qi++) {
+    unsigned n = queue[qi];
+    for (const auto & cn : m_nodes[n].next) {
+      unsigned f = m_nodes[n].fail;
+      std::map<char, unsigned>::const_iterator it;
+      while ((it = m_nodes[f].next.find(cn.first)) == m_nodes[f].next.end() && f)
+        f = m_nodes[f].fail;
+      node & child = m_nodes[cn.second];
+      child.fail = (it != m_nodes[f].next.end() ? it->second : 0);
+      child.output = (!m_nodes[child.fail].entries.empty() ? child.fail
+                      : m_nodes[child.fail].output);
+      queue.push_back(cn.second);
+    }
+  }
+}
+
+void literal_index::find(const char * str, std::vector<unsigned> & found) const
+{
+  unsigned n = 0;
+  for (const char * p = str; *p; p++) {
+    std::map<char, unsigned>::const_iterator it;
+    while ((it = m_nodes[n].next.find(*p)) == m_nodes[n].next.end() && n)
+      n = m_nodes[n].fail;
+    n = (it != m_nodes[n].next.end() ? it->second : 0);
+    for (unsigned o = (!m_nodes[n].entries.empty() ? n : m_nodes[n].output); o;
+         o = m_nodes[o].output)
+      found.insert(found.end(), m_nodes[o].entries.begin(), m_nodes[o].entries.end());
+  }
+}
+
 /// Drive database class. Stores custom entries read from file.
 /// Provides transparent access to concatenation of custom and
 /// default table.
@@ -69,9 +364,45 @@ public:
   /// Append new custom entry.
   void push_back(const drive_settings & src);
 
+  /// Append N custom entries with strings in POOL.
+  /// Takes ownership of POOL which must be allocated with new [].
+  void push_back(const drive_settings * entries, unsigned n, char * pool);
+
   /// Append builtin table.
   void append(const drive_settings * builtin_tab, unsigned builtin_size)
-    { m_builtin_tab = builtin_tab; m_builtin_size = builtin_size; }
+    { m_builtin_tab = builtin_tab; m_builtin_size = builtin_size; clear_caches(); }
+
+  /// Return true if model regexp of entry I fully matches STR.
+  /// The regular expression is compiled on first use and then kept.
+  bool match_model(unsigned i, const char * str)
+    { return match(i, false, str); }
+
+  /// Same as above for firmware regexp.
+  bool match_firmware(unsigned i, const char * str)
+    { return match(i, true, str); }
+
+  /// Get indexes of ATA entries whose model regexp may match MODEL,
+  /// in ascending order.  Only entries with a required literal substring
+  /// of the regexp found in MODEL or without such a literal are returned.
+  void get_model_candidates(const char * model, std::vector<unsigned> & cands);
+
+  /// Get indexes of VERSION entries, in ascending order.
+  const std::vector<unsigned> & get_version_entries()
+    { build_index(); return m_version_entries; }
+
+  /// USB entry with parsed names and '-d' type.
+  struct usb_entry
+  {
+    unsigned index; //< Entry index
+    bool exact; //< Model regexp is known to match the USB ID
+    bool type_ok; //< False on syntax error in '-d' type
+    usb_dev_info info;
+  };
+
+  /// Get USB entries whose model regexp may match the VENDOR_ID:PRODUCT_ID
+  /// string, in ascending order of entry index.
+  void get_usb_candidates(int vendor_id, int product_id,
+                          std::vector<const usb_entry *> & cands);
 
 private:
   const drive_settings * m_builtin_tab;
@@ -80,6 +411,39 @@ private:
   std::vector<drive_settings> m_custom_tab;
   std::vector<char *> m_custom_strings;
 
+  struct cached_regex
+  {
+    regular_expression regex;
+    signed char state = 0; //< 0: not compiled, 1: ok, -1: error
+  };
+
+  // Compiled regexps, model of entry I at 2*I, firmware at 2*I+1.
+  std::vector<cached_regex> m_regex_cache;
+
+  bool match(unsigned i, bool firmware, const char * str);
+
+  // Index of ATA entries, built on first use.
+  bool m_index_valid = false;
+  literal_index m_model_index;
+  std::vector<unsigned> m_unindexed_entries; //< Without required literal
+  std::vector<unsigned> m_version_entries;
+
+  void build_index();
+
+  // Index of USB entries, built on first use.
+  bool m_usb_index_valid = false;
+  std::vector<usb_entry> m_usb_entries;
+  // Positions in m_usb_entries by vendor:product ID, by vendor ID only
+  // if product ID is a wildcard, and of the remaining entries.
+  std::unordered_map<uint32_t, std::vector<unsigned> > m_usb_id_index;
+  std::unordered_map<uint32_t, std::vector<unsigned> > m_usb_vendor_index;
+  std::vector<unsigned> m_usb_unindexed;
+
+  void build_usb_index();
+
+  void clear_caches()
+    { m_regex_cache.clear(); m_index_valid = false; m_usb_index_valid = false; }
+
   const char * copy_string(const char * str);
 
   drive_database(const drive_database &);
@@ -112,6 +476,19 @@ void drive_database::push_back(const drive_settings & src)
   dest.warningmsg     = copy_string(src.warningmsg);
   dest.presets        = copy_string(src.presets);
   m_custom_tab.push_back(dest);
+  clear_caches(); // Indexes of builtin entries have changed
+}
+
+void drive_database::push_back(const drive_settings * entries, unsigned n, char * pool)
+{
+  try {
+    m_custom_strings.push_back(pool);
+  }
+  catch (...) {
+    delete [] pool; throw;
+  }
+  m_custom_tab.insert(m_custom_tab.end(), entries, entries + n);
+  clear_caches();
 }
 
 const char * drive_database::copy_string(const char * src)
@@ -187,13 +564,56 @@ static bool compile(regular_expression & regex, const char *pattern)
   return true;
 }
 
-// Compile & match a regular expression.
-static bool match(const char * pattern, const char * str)
+bool drive_database::match(unsigned i, bool firmware, const char * str)
 {
-  regular_expression regex;
-  if (!compile(regex, pattern))
+  if (m_regex_cache.empty())
+    m_regex_cache.resize(2 * size());
+  cached_regex & cr = m_regex_cache[2 * i + (firmware ? 1 : 0)];
+  if (!cr.state) {
+    const drive_settings & dbentry = (*this)[i];
+    cr.state = (compile(cr.regex, (firmware ? dbentry.firmwareregexp
+                                            : dbentry.modelregexp)) ? 1 : -1);
+  }
+  if (cr.state < 0)
     return false;
-  return regex.full_match(str);
+  return cr.regex.full_match(str);
+}
+
+void drive_database::build_index()
+{
+  if (m_index_valid)
+    return;
+  m_model_index.clear();
+  m_unindexed_entries.clear();
+  m_version_entries.clear();
+  std::vector<std::string> literals;
+  for (unsigned i = 0; i < size(); i++) {
+    const drive_settings & dbentry = (*this)[i];
+    dbentry_type t = get_dbentry_type(&dbentry);
+    if (t == DBENTRY_VERSION)
+      m_version_entries.push_back(i);
+    if (t != DBENTRY_ATA)
+      continue;
+    literals.clear();
+    get_required_literals(dbentry.modelregexp, literals);
+    if (literals.size() == 1 && literals[0].empty())
+      m_unindexed_entries.push_back(i);
+    else {
+      for (const std::string & lit : literals)
+        m_model_index.add(lit, i);
+    }
+  }
+  m_model_index.build();
+  m_index_valid = true;
+}
+
+void drive_database::get_model_candidates(const char * model, std::vector<unsigned> & cands)
+{
+  build_index();
+  cands = m_unindexed_entries;
+  m_model_index.find(model, cands);
+  std::sort(cands.begin(), cands.end());
+  cands.erase(std::unique(cands.begin(), cands.end()), cands.end());
 }
 
 // Searches knowndrives[] for a drive with the given model number and firmware
@@ -208,34 +628,35 @@ static const drive_settings * lookup_drive(const char * model, const char * firm
   if (!firmware)
     firmware = "";
 
-  for (unsigned i = 0; i < knowndrives.size(); i++) {
-    dbentry_type t = get_dbentry_type(&knowndrives[i]);
-    // Get version if requested
-    if (t == DBENTRY_VERSION) {
-      if (dbversion)
-        parse_version(*dbversion, knowndrives[i].modelfamily);
-      continue;
-    }
-
-    // Skip DEFAULT and USB entries
-    if (t != DBENTRY_ATA)
-      continue;
-
+  // Check only entries which may match the model
+  std::vector<unsigned> cands;
+  knowndrives.get_model_candidates(model, cands);
+  unsigned found = knowndrives.size();
+  for (unsigned i : cands) {
     // Check whether model matches the regular expression in knowndrives[i].
-    if (!match(knowndrives[i].modelregexp, model))
+    if (!knowndrives.match_model(i, model))
       continue;
 
     // Model matches, now check firmware. "" matches always.
     if (!(  !*knowndrives[i].firmwareregexp
-          || match(knowndrives[i].firmwareregexp, firmware)))
+          || knowndrives.match_firmware(i, firmware)))
       continue;
 
     // Found
-    return &knowndrives[i];
+    found = i;
+    break;
+  }
+
+  // Get version if requested, from entries before the match
+  if (dbversion) {
+    for (unsigned i : knowndrives.get_version_entries()) {
+      if (i > found)
+        break;
+      parse_version(*dbversion, knowndrives[i].modelfamily);
+    }
   }
 
-  // Not found
-  return 0;
+  return (found < knowndrives.size() ? &knowndrives[found] : nullptr);
 }
 
 
@@ -309,6 +730,85 @@ static void parse_usb_names(const char * names, usb_dev_info & info)
     info.usb_bridge = names+n3;
 }
 
+void drive_database::build_usb_index()
+{
+  if (m_usb_index_valid)
+    return;
+  m_usb_entries.clear();
+  m_usb_id_index.clear();
+  m_usb_vendor_index.clear();
+  m_usb_unindexed.clear();
+  std::vector<std::string> ids;
+  for (unsigned i = 0; i < size(); i++) {
+    const drive_settings & dbentry = (*this)[i];
+    if (get_dbentry_type(&dbentry) != DBENTRY_USB)
+      continue;
+    usb_entry e;
+    e.index = i;
+    e.type_ok = parse_usb_type(dbentry.presets, e.info.usb_type);
+    parse_usb_names(dbentry.modelfamily, e.info);
+    unsigned pos = m_usb_entries.size();
+
+    // Index all IDs if the regexp matches only a few
+    const char * re = dbentry.modelregexp;
+    ids.clear();
+    e.exact = expand_regex(re, re + strlen(re), ids, 64);
+    if (e.exact) {
+      for (const std::string & id : ids) {
+        unsigned vendor_id = 0, product_id = 0; int n = -1;
+        char buf[16];
+        // Ignore IDs which could never match the formatted string
+        if (!(   sscanf(id.c_str(), "0x%4x:0x%4x%n", &vendor_id, &product_id, &n) == 2
+              && n == (int)id.size()
+              && snprintf(buf, sizeof(buf), "0x%04x:0x%04x", vendor_id, product_id) > 0
+              && id == buf                                                          ))
+          continue;
+        std::vector<unsigned> & v = m_usb_id_index[(vendor_id << 16) | product_id];
+        if (v.empty() || v.back() != pos)
+          v.push_back(pos);
+      }
+    }
+    else {
+      // "0xVVVV:0x....", top level alternatives may have other vendor IDs
+      std::vector< std::pair<const char *, const char *> > alts;
+      split_alternatives(re, re + strlen(re), alts);
+      unsigned vendor_id = 0; int n = -1;
+      char buf[16];
+      if (   alts.size() == 1
+          && sscanf(re, "0x%4x:%n", &vendor_id, &n) == 1 && n == 7
+          && snprintf(buf, sizeof(buf), "0x%04x:", vendor_id) > 0
+          && !strncmp(re, buf, 7)                                   )
+        m_usb_vendor_index[vendor_id].push_back(pos);
+      else
+        m_usb_unindexed.push_back(pos);
+    }
+    m_usb_entries.push_back(e);
+  }
+  m_usb_index_valid = true;
+}
+
+void drive_database::get_usb_candidates(int vendor_id, int product_id,
+                                        std::vector<const usb_entry *> & cands)
+{
+  build_usb_index();
+  std::vector<unsigned> pos = m_usb_unindexed;
+  if (   0 <= vendor_id  && vendor_id  <= 0xffff
+      && 0 <= product_id && product_id <= 0xffff) {
+    std::unordered_map<uint32_t, std::vector<unsigned> >::const_iterator it =
+      m_usb_id_index.find((vendor_id << 16) | product_id);
+    if (it != m_usb_id_index.end())
+      pos.insert(pos.end(), it->second.begin(), it->second.end());
+    it = m_usb_vendor_index.find(vendor_id);
+    if (it != m_usb_vendor_index.end())
+      pos.insert(pos.end(), it->second.begin(), it->second.end());
+    std::sort(pos.begin(), pos.end());
+  }
+
+  cands.clear();
+  for (unsigned p : pos)
+    cands.push_back(&m_usb_entries[p]);
+}
+
 // Search drivedb for USB device with vendor:product ID.
 int lookup_usb_device(int vendor_id, int product_id, int bcd_device,
                       usb_dev_info & info, usb_dev_info & info2)
@@ -321,28 +821,28 @@ int lookup_usb_device(int vendor_id, int product_id, int bcd_device,
   else
     bcd_dev_str[0] = 0;
 
+  // Check only USB entries which may match the ID
+  std::vector<const drive_database::usb_entry *> cands;
+  knowndrives.get_usb_candidates(vendor_id, product_id, cands);
+
   int found = 0;
-  for (unsigned i = 0; i < knowndrives.size(); i++) {
+  for (const drive_database::usb_entry * e : cands) {
+    unsigned i = e->index;
     const drive_settings & dbentry = knowndrives[i];
 
-    // Skip drive entries
-    if (get_dbentry_type(&dbentry) != DBENTRY_USB)
-      continue;
-
     // Check whether USB vendor:product ID matches
-    if (!match(dbentry.modelregexp, usb_id_str))
+    if (!(e->exact || knowndrives.match_model(i, usb_id_str)))
       continue;
 
-    // Parse '-d type'
-    usb_dev_info d;
-    if (!parse_usb_type(dbentry.presets, d.usb_type))
+    // Use parsed '-d type'
+    if (!e->type_ok)
       return 0; // Syntax error
-    parse_usb_names(dbentry.modelfamily, d);
+    const usb_dev_info & d = e->info;
 
     // If two entries with same vendor:product ID have different
     // types, use bcd_device (if provided by OS) to select entry.
     if (  *dbentry.firmwareregexp && *bcd_dev_str
-        && match(dbentry.firmwareregexp, bcd_dev_str)) {
+        && knowndrives.match_firmware(i, bcd_dev_str)) {
       // Exact match including bcd_device
       info = d; found = 1;
       break;
@@ -519,10 +1019,10 @@ int showmatchingpresets(const char *model, const char *firmware)
   const char * firmwaremsg = (firmware ? firmware : "(any)");
 
   for (unsigned i = 0; i < knowndrives.size(); i++) {
-    if (!match(knowndrives[i].modelregexp, model))
+    if (!knowndrives.match_model(i, model))
       continue;
     if (   firmware && *knowndrives[i].firmwareregexp
-        && !match(knowndrives[i].firmwareregexp, firmware))
+        && !knowndrives.match_firmware(i, firmware))
         continue;
     // Found
     if (++cnt == 1)
@@ -873,8 +1373,106 @@ static bool parse_drive_database(parse_ptr src, drive_database & db, const char
   return ok;
 }
 
-// Read drive database from file.
-bool read_drive_database(const char * path)
+// Binary drive database file "PATH.bin":
+// Header, table with offsets of the 5 strings of each entry, string pool.
+// The file is only used if size and hash of the contents of the text file
+// PATH are unchanged.  The modification time is not used because it may
+// be preserved or clamped if the file is replaced (cp -p, tar, ...).
+struct drivedb_bin_header
+{
+  char magic[8];
+  uint32_t format_version;
+  uint32_t byte_order;
+  uint64_t text_size;
+  uint64_t text_hash;
+  uint32_t num_entries;
+  uint32_t pool_size;
+};
+
+static const char drivedb_bin_magic[8] = "SMDRVDB";
+const uint32_t drivedb_bin_format_version = 2;
+const uint32_t drivedb_bin_byte_order = 0x01020304;
+const int drivedb_bin_fields = 5;
+
+static std::string get_drivedb_bin_path(const char * path)
+{
+  return std::string(path) + ".bin";
+}
+
+// Get FNV-1a hash of the contents of file PATH.
+static bool get_drivedb_text_hash(const char * path, uint64_t & hash)
+{
+  stdio_file f(path, "rb");
+  if (!f)
+    return false;
+  hash = 0xcbf29ce484222325ULL;
+  unsigned char buf[16384];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      hash ^= buf[i];
+      hash *= 0x100000001b3ULL;
+    }
+  }
+  return !ferror(f);
+}
+
+// Read binary drive database if up to date.
+// Return false silently if missing, outdated or invalid.
+static bool read_drive_database_bin(const char * path, drive_database & db)
+{
+  struct stat st;
+  if (stat(path, &st))
+    return false;
+  stdio_file f(get_drivedb_bin_path(path).c_str(), "rb");
+  if (!f)
+    return false;
+
+  drivedb_bin_header hdr;
+  uint64_t text_hash = 0;
+  if (!(   fread(&hdr, sizeof(hdr), 1, f) == 1
+        && !memcmp(hdr.magic, drivedb_bin_magic, sizeof(hdr.magic))
+        && hdr.format_version == drivedb_bin_format_version
+        && hdr.byte_order == drivedb_bin_byte_order
+        && hdr.text_size == (uint64_t)st.st_size
+        && 0 < hdr.pool_size && hdr.pool_size <= 0x1000000
+        && hdr.num_entries <= hdr.pool_size
+        && get_drivedb_text_hash(path, text_hash)
+        && hdr.text_hash == text_hash                       ))
+    return false;
+
+  std::vector<uint32_t> offsets(hdr.num_entries * drivedb_bin_fields);
+  char * pool = new char[hdr.pool_size + 1];
+  if (!(   fread(offsets.data(), sizeof(uint32_t), offsets.size(), f) == offsets.size()
+        && fread(pool, 1, hdr.pool_size + 1, f) == hdr.pool_size // Check EOF
+        && !pool[hdr.pool_size - 1]                              )) {
+    delete [] pool;
+    return false;
+  }
+
+  std::vector<drive_settings> entries(hdr.num_entries);
+  for (unsigned i = 0; i < offsets.size(); i++) {
+    if (offsets[i] >= hdr.pool_size) {
+      delete [] pool;
+      return false;
+    }
+    const char * str = pool + offsets[i];
+    drive_settings & entry = entries[i / drivedb_bin_fields];
+    switch (i % drivedb_bin_fields) {
+      case 0: entry.modelfamily    = str; break;
+      case 1: entry.modelregexp    = str; break;
+      case 2: entry.firmwareregexp = str; break;
+      case 3: entry.warningmsg     = str; break;
+      case 4: entry.presets        = str; break;
+    }
+  }
+
+  db.push_back(entries.data(), entries.size(), pool);
+  return true;
+}
+
+// Read drive database from text file.
+static bool read_drive_database_text(const char * path, drive_database & db)
 {
   stdio_file f(path, "r"
 #ifdef __CYGWIN__ // Allow files with '\r\n'.
@@ -886,7 +1484,74 @@ bool read_drive_database(const char * path)
     return false;
   }
 
-  return parse_drive_database(parse_ptr(f), knowndrives, path);
+  return parse_drive_database(parse_ptr(f), db, path);
+}
+
+// Read drive database from file.
+bool read_drive_database(const char * path)
+{
+  if (read_drive_database_bin(path, knowndrives))
+    return true;
+  return read_drive_database_text(path, knowndrives);
+}
+
+// Read drive database from text file and write binary database file.
+bool compile_drive_database(const char * path)
+{
+  drive_database db;
+  if (!read_drive_database_text(path, db))
+    return false;
+  struct stat st; uint64_t text_hash = 0;
+  if (stat(path, &st) || !get_drivedb_text_hash(path, text_hash)) {
+    lib_printf("%s: cannot get file status\n", path);
+    return false;
+  }
+
+  // Build string pool, store each distinct string once
+  std::string pool;
+  std::map<std::string, uint32_t> pool_index;
+  std::vector<uint32_t> offsets;
+  for (unsigned i = 0; i < db.custom_size(); i++) {
+    const drive_settings & entry = db[i];
+    for (const char * str : {entry.modelfamily, entry.modelregexp, entry.firmwareregexp,
+                             entry.warningmsg, entry.presets}) {
+      std::map<std::string, uint32_t>::const_iterator it = pool_index.find(str);
+      if (it == pool_index.end()) {
+        it = pool_index.insert({str, (uint32_t)pool.size()}).first;
+        pool.append(str, strlen(str) + 1);
+      }
+      offsets.push_back(it->second);
+    }
+  }
+  if (pool.empty())
+    pool += '\0';
+
+  drivedb_bin_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, drivedb_bin_magic, sizeof(hdr.magic));
+  hdr.format_version = drivedb_bin_format_version;
+  hdr.byte_order = drivedb_bin_byte_order;
+  hdr.text_size = st.st_size;
+  hdr.text_hash = text_hash;
+  hdr.num_entries = db.custom_size();
+  hdr.pool_size = pool.size();
+
+  std::string binpath = get_drivedb_bin_path(path);
+  stdio_file f(binpath.c_str(), "wb");
+  if (!f) {
+    lib_printf("%s: cannot create binary drive database file\n", binpath.c_str());
+    return false;
+  }
+  bool ok = (   fwrite(&hdr, sizeof(hdr), 1, f) == 1
+             && fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), f) == offsets.size()
+             && fwrite(pool.data(), 1, pool.size(), f) == pool.size()
+             && f.close()                                                                   );
+  if (!ok) {
+    lib_printf("%s: write error\n", binpath.c_str());
+    unlink(binpath.c_str());
+    return false;
+  }
+  return true;
 }
 
 // Get path for additional database file
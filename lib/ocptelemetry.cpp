@@ -11,86 +11,438 @@
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
-#include <smartmon/ocptelemetry.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h> // getpid()
+#endif
+#ifdef _WIN32
+#include <process.h> // getpid()
+#endif
 
-#include <cmath>
+#include <algorithm>
+
+#include <smartmon/ocptelemetry.h>
+#include <smartmon/scsicmds.h>
+#include <smartmon/sg_unaligned.h>
+#include <smartmon/utility.h>
 
 #define MIN(_A, _B) ((_A) < (_B) ? (_A) : (_B))
 
 namespace smartmon {
 
-static void ocp_process_stat_id_strings(uint8_t *data, size_t data_len, ocp_string_def *string_def)
+static bool ocp_string_in_ascii_table(const ocp_string_def *string_def,
+                                      const uint8_t offset[8], uint8_t len)
+{
+  uint64_t start = sg_get_unaligned_le64(offset);
+  return (start <= string_def->ascii_table_size &&
+          len <= string_def->ascii_table_size - start);
+}
+
+static bool ocp_string_entry_less(const ocp_string_entry & a, const ocp_string_entry & b)
+{
+  return a.key < b.key;
+}
+
+// Sort table for binary search.  If a key occurs more than once, the last
+// entry in the log wins.
+static void ocp_sort_string_entries(std::vector<ocp_string_entry> & entries)
+{
+  std::stable_sort(entries.begin(), entries.end(), ocp_string_entry_less);
+  size_t n = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (n > 0 && entries[n - 1].key == entries[i].key)
+      entries[n - 1] = entries[i];
+    else
+      entries[n++] = entries[i];
+  }
+  entries.resize(n);
+}
+
+static void ocp_process_stat_id_strings(const uint8_t *data, size_t data_len,
+                                       ocp_string_def *string_def)
 {
   while (data_len > 0) {
-    struct ocp_statistic_id_string_table_entry *entry =
-      (struct ocp_statistic_id_string_table_entry *)data;
-    string_def->stat_id_string_map[entry->vu_statistic_id] = *entry;
+    const struct ocp_statistic_id_string_table_entry *entry =
+      (const struct ocp_statistic_id_string_table_entry *)data;
+    if (ocp_string_in_ascii_table(string_def, entry->ascii_id_offset, entry->ascii_id_len)) {
+      ocp_string_entry e = { sg_get_unaligned_le16(&entry->vu_statistic_id), entry->ascii_id_len,
+                             sg_get_unaligned_le64(entry->ascii_id_offset) };
+      string_def->stat_id_strings.push_back(e);
+    }
     data_len -= sizeof *entry;
     data += sizeof *entry;
   }
 }
 
-static void ocp_process_event_strings(uint8_t *data, size_t data_len, ocp_string_def *string_def)
+static void ocp_process_event_strings(const uint8_t *data, size_t data_len,
+                                      ocp_string_def *string_def)
 {
   while (data_len > 0) {
-    uint32_t key;
-    struct ocp_event_id_string_table_entry *entry =
-      (struct ocp_event_id_string_table_entry *)data;
-    key = OCP_EVENT_KEY(entry->dbg_class, entry->id);
-    string_def->event_string_map[key] = *entry;
+    const struct ocp_event_id_string_table_entry *entry =
+      (const struct ocp_event_id_string_table_entry *)data;
+    if (ocp_string_in_ascii_table(string_def, entry->ascii_id_offset, entry->ascii_id_len)) {
+      ocp_string_entry e = { (uint32_t)OCP_EVENT_KEY(entry->dbg_class, entry->id),
+                             entry->ascii_id_len, sg_get_unaligned_le64(entry->ascii_id_offset) };
+      string_def->event_strings.push_back(e);
+    }
     data_len -= sizeof *entry;
     data += sizeof *entry;
   }
 }
 
-static bool validate_ocp_telemetry_data_header(struct ocp_telemetry_data_header *header,
-                                               unsigned nsectors)
+// Build the string lookup tables from the string area which starts with
+// the strings header and has been validated before.
+static void ocp_process_string_tables(const struct ocp_telemetry_strings_header *header,
+                                      ocp_string_def *string_def)
 {
-  size_t max_dword = sizeof *header;
+  const uint8_t *area = string_def->string_area.data();
+
+  string_def->ascii_table_offset = header->ascii_table_start << 2;
+  string_def->ascii_table_size = header->ascii_table_size << 2;
+
+  string_def->stat_id_strings.clear();
+  string_def->stat_id_strings.reserve(header->statistics_id_string_table_size /
+                                      (sizeof(ocp_statistic_id_string_table_entry) >> 2));
+  ocp_process_stat_id_strings(area + (header->statistics_id_string_table_start << 2),
+                              header->statistics_id_string_table_size << 2, string_def);
+  ocp_sort_string_entries(string_def->stat_id_strings);
 
-  if (header->statistic2_size_dword > 0 &&
-      header->statistic2_start_dword + header->statistic2_size_dword > max_dword) {
-    max_dword = header->statistic2_start_dword + header->statistic2_size_dword;
-  } else if (header->statistic1_size_dword > 0 &&
-             header->statistic1_start_dword + header->statistic1_size_dword > max_dword) {
-    max_dword = header->statistic1_start_dword + header->statistic1_size_dword;
+  string_def->event_strings.clear();
+  string_def->event_strings.reserve((header->event_string_table_size +
+                                     header->vu_event_string_table_size) /
+                                    (sizeof(ocp_event_id_string_table_entry) >> 2));
+  ocp_process_event_strings(area + (header->event_string_table_start << 2),
+                            header->event_string_table_size << 2, string_def);
+  ocp_process_event_strings(area + (header->vu_event_string_table_start << 2),
+                            header->vu_event_string_table_size << 2, string_def);
+  ocp_sort_string_entries(string_def->event_strings);
+}
+
+static bool ocp_find_string(const ocp_string_def *string_def,
+                            const std::vector<ocp_string_entry> & entries,
+                            uint32_t key, ocp_string_ref *ref)
+{
+  ocp_string_entry k = { key, 0, 0 };
+  std::vector<ocp_string_entry>::const_iterator it =
+    std::lower_bound(entries.begin(), entries.end(), k, ocp_string_entry_less);
+  if (it == entries.end() || it->key != key)
+    return false;
+  ref->str = (const char *)string_def->string_area.data() + string_def->ascii_table_offset
+             + it->offset;
+  ref->len = it->len;
+  return true;
+}
+
+static bool ocp_stat_str_less(const ocp_stat_str_def & a, uint16_t id)
+{
+  return a.id < id;
+}
+
+const char * ocp_builtin_stat_id_to_str(uint16_t id)
+{
+  const ocp_stat_str_def *end = ocp_builtin_stat_str + OCP_BUILTIN_STAT_STR_LEN;
+  const ocp_stat_str_def *p = std::lower_bound(ocp_builtin_stat_str, end, id, ocp_stat_str_less);
+  return (p != end && p->id == id ? p->desc : nullptr);
+}
+
+bool ocp_find_stat_id_string(const ocp_string_def *string_def, uint16_t id,
+                             ocp_string_ref *ref)
+{
+  return ocp_find_string(string_def, string_def->stat_id_strings, id, ref);
+}
+
+bool ocp_find_event_string(const ocp_string_def *string_def, uint8_t dbg_class,
+                           const uint8_t id[2], ocp_string_ref *ref)
+{
+  return ocp_find_string(string_def, string_def->event_strings,
+                         OCP_EVENT_KEY(dbg_class, id), ref);
+}
+
+static bool ocp_get_uint(const uint8_t *data, size_t size, uint64_t *val)
+{
+  switch (size) {
+  case 1: *val = data[0]; return true;
+  case 2: *val = sg_get_unaligned_le16(data); return true;
+  case 4: *val = sg_get_unaligned_le32(data); return true;
+  case 8: *val = sg_get_unaligned_le64(data); return true;
+  default: return false;
   }
+}
 
-  if (header->event2_FIFO_size_dword > 0 &&
-      header->event2_FIFO_start_dword + header->event2_FIFO_size_dword > max_dword) {
-    max_dword = header->event2_FIFO_start_dword + header->event2_FIFO_size_dword;
-  } else if (header->event1_FIFO_size_dword > 0 &&
-             header->event1_FIFO_start_dword + header->event1_FIFO_size_dword > max_dword) {
-    max_dword = header->event1_FIFO_start_dword + header->event1_FIFO_size_dword;
+static bool ocp_get_int(const uint8_t *data, size_t size, int64_t *val)
+{
+  switch (size) {
+  case 1: *val = (int8_t)data[0]; return true;
+  case 2: *val = (int16_t)sg_get_unaligned_le16(data); return true;
+  case 4: *val = (int32_t)sg_get_unaligned_le32(data); return true;
+  case 8: *val = (int64_t)sg_get_unaligned_le64(data); return true;
+  default: return false;
   }
+}
+
+size_t ocp_stat_desc_view::desc_size(const uint8_t * desc, size_t avail)
+{
+  if (avail >= 2 && !sg_get_unaligned_le16(desc))
+    return 0; // End of list
+  if (avail < sizeof(ocp_statistic_header))
+    return sizeof(ocp_statistic_header);
+  return sizeof(ocp_statistic_header) + ((size_t)sg_get_unaligned_le16(desc + 6) << 2);
+}
 
-  if (nsectors < (size_t)ceil(max_dword/128) + 1) {
+uint16_t ocp_stat_desc_view::id() const
+{
+  return sg_get_unaligned_le16(m_desc);
+}
+
+bool ocp_stat_desc_view::get_uint(uint64_t * val) const
+{
+  if (stat_type() != OCP_STAT_TYPE_SINGLE)
+    return false;
+  return ocp_get_uint(data(), data_size(), val);
+}
+
+bool ocp_stat_desc_view::get_int(int64_t * val) const
+{
+  if (stat_type() != OCP_STAT_TYPE_SINGLE)
     return false;
+  return ocp_get_int(data(), data_size(), val);
+}
+
+unsigned ocp_stat_desc_view::num_elements() const
+{
+  if (stat_type() != OCP_STAT_TYPE_ARRAY || data_size() < 4)
+    return 0;
+  unsigned n = sg_get_unaligned_le16(data() + 2) + 1;
+  size_t max_n = (data_size() - 4) / element_size();
+  return (n < max_n ? n : (unsigned)max_n);
+}
+
+size_t ocp_stat_desc_view::element_size() const
+{
+  return (data_size() >= 4 ? data()[0] + 1 : 1);
+}
+
+bool ocp_stat_desc_view::get_element_uint(unsigned i, uint64_t * val) const
+{
+  if (i >= num_elements())
+    return false;
+  return ocp_get_uint(element(i), element_size(), val);
+}
+
+bool ocp_stat_desc_view::get_element_int(unsigned i, int64_t * val) const
+{
+  if (i >= num_elements())
+    return false;
+  return ocp_get_int(element(i), element_size(), val);
+}
+
+const ocp_ata_log_stat_desc * ocp_stat_desc_view::ata_log() const
+{
+  if (!(stat_type() == OCP_STAT_TYPE_CUSTOM && id() == 0x0002
+        && m_size >= sizeof(ocp_ata_log_stat_desc)))
+    return nullptr;
+  return (const ocp_ata_log_stat_desc *)m_desc;
+}
+
+const ocp_scsi_log_stat_desc * ocp_stat_desc_view::scsi_log() const
+{
+  if (!(stat_type() == OCP_STAT_TYPE_CUSTOM && id() == 0x0003
+        && m_size >= sizeof(ocp_scsi_log_stat_desc)))
+    return nullptr;
+  return (const ocp_scsi_log_stat_desc *)m_desc;
+}
+
+const ocp_hdd_spinup_stat_desc * ocp_stat_desc_view::hdd_spinup() const
+{
+  if (!(stat_type() == OCP_STAT_TYPE_CUSTOM && id() == 0x6006
+        && m_size >= sizeof(ocp_hdd_spinup_stat_desc)))
+    return nullptr;
+  return (const ocp_hdd_spinup_stat_desc *)m_desc;
+}
+
+size_t ocp_event_desc_view::desc_size(const uint8_t * desc, size_t avail)
+{
+  if (avail >= 1 && !desc[0])
+    return 0; // End of FIFO
+  if (avail < sizeof(ocp_event_descriptor))
+    return sizeof(ocp_event_descriptor);
+  if (desc[0] == OCP_EVENT_CLASS_STATISTIC_SNAP) {
+    // The statistic descriptor header is needed to determine the complete length
+    const uint8_t * sp = desc + sizeof(ocp_event_descriptor);
+    if (avail < sizeof(ocp_event_descriptor) + sizeof(ocp_statistic_header))
+      return sizeof(ocp_event_descriptor) + sizeof(ocp_statistic_header);
+    return sizeof(ocp_event_descriptor) + sizeof(ocp_statistic_header)
+           + ((size_t)sg_get_unaligned_le16(sp + 6) << 2);
   }
+  return sizeof(ocp_event_descriptor) + ((size_t)desc[3] << 2);
+}
 
+bool ocp_event_desc_view::get_timestamp(uint64_t * timestamp) const
+{
+  if (!(class_type() == OCP_EVENT_CLASS_TIMESTAMP && data_size() >= sizeof(ocp_event_timestamp)))
+    return false;
+  *timestamp = sg_get_unaligned_le64(data());
   return true;
 }
 
-static bool read_ocp_telemetry_data_range_sata(ata_device * device,
-                                               size_t start_dword, size_t size_dword,
-                                               char *dest)
+const ocp_event_media_wear * ocp_event_desc_view::media_wear() const
+{
+  if (!(class_type() == OCP_EVENT_CLASS_MEDIA_WEAR && id() == OCP_MEDIA_WEAR_EVENT_MEDIA_WEAR
+        && data_size() >= sizeof(ocp_event_media_wear)))
+    return nullptr;
+  return (const ocp_event_media_wear *)data();
+}
+
+ocp_stat_desc_view ocp_event_desc_view::stat_snapshot() const
+{
+  if (!(class_type() == OCP_EVENT_CLASS_STATISTIC_SNAP && data_size() >= sizeof(ocp_statistic_header)))
+    return ocp_stat_desc_view();
+  return ocp_stat_desc_view(data(), data_size());
+}
+
+const ocp_event_virtual_fifo * ocp_event_desc_view::virtual_fifo() const
+{
+  if (!(class_type() == OCP_EVENT_CLASS_VIRTUAL_FIFO && data_size() >= sizeof(ocp_event_virtual_fifo)))
+    return nullptr;
+  return (const ocp_event_virtual_fifo *)data();
+}
+
+const ocp_event_class_0Dh * ocp_event_desc_view::sata_transport() const
+{
+  if (!(class_type() == OCP_EVENT_CLASS_SATA_TRANSPORT && data_size() >= sizeof(ocp_event_class_0Dh)))
+    return nullptr;
+  return (const ocp_event_class_0Dh *)data();
+}
+
+size_t ocp_event_desc_view::class_data_size() const
+{
+  size_t size;
+  switch (class_type()) {
+  case OCP_EVENT_CLASS_TIMESTAMP:
+    size = sizeof(ocp_event_timestamp); break;
+  case OCP_EVENT_CLASS_MEDIA_WEAR:
+    size = sizeof(ocp_event_media_wear); break;
+  case OCP_EVENT_CLASS_STATISTIC_SNAP:
+    size = data_size(); break;
+  case OCP_EVENT_CLASS_VIRTUAL_FIFO:
+    size = sizeof(ocp_event_virtual_fifo); break;
+  case OCP_EVENT_CLASS_SATA_TRANSPORT:
+    size = sizeof(ocp_event_class_0Dh); break;
+  default:
+    size = 0; break;
+  }
+  return MIN(size, data_size());
+}
+
+const ocp_event_vu * ocp_event_desc_view::vu_event(size_t * vu_data_size) const
+{
+  size_t offset = class_data_size();
+  if (class_type() >= 0x80 || data_size() < offset + sizeof(ocp_event_vu))
+    return nullptr;
+  *vu_data_size = data_size() - offset - sizeof(ocp_event_vu);
+  return (const ocp_event_vu *)(data() + offset);
+}
+
+static bool validate_ocp_telemetry_data_header(struct ocp_telemetry_data_header *header,
+                                               unsigned nsectors)
+{
+  // All areas must fit into the log pages following the internal status page
+  uint64_t max_dword = (uint64_t)(nsectors - 1) * 128;
+  uint64_t end_dword = sizeof *header >> 2;
+
+  const uint64_t areas[][2] = {
+    { header->statistic1_start_dword, header->statistic1_size_dword },
+    { header->statistic2_start_dword, header->statistic2_size_dword },
+    { header->event1_FIFO_start_dword, header->event1_FIFO_size_dword },
+    { header->event2_FIFO_start_dword, header->event2_FIFO_size_dword },
+  };
+
+  for (const auto & area : areas) {
+    if (!area[1])
+      continue;
+    if (area[0] > max_dword || area[1] > max_dword - area[0])
+      return false;
+    if (area[0] + area[1] > end_dword)
+      end_dword = area[0] + area[1];
+  }
+
+  return (end_dword <= max_dword);
+}
+
+static bool ocp_read_log_ext(ata_device * device, unsigned char logaddr,
+                             unsigned page, void * data, unsigned nsectors)
 {
-  uint32_t page[128];
-  size_t page_idx = ceil(start_dword / 128) + 1;
-  size_t page_offset = start_dword - (page_idx - 1) * 128;
-  size_t dwords_to_read = size_dword;
+  ata_cmd_in in;
+  in.in_regs.command      = ATA_READ_LOG_EXT;
+  in.set_data_in_48bit(data, nsectors);
+  in.in_regs.lba_low      = logaddr;
+  in.in_regs.lba_mid_16   = page;
+  return device->ata_pass_through(in);
+}
 
-  while (dwords_to_read > 0) {
-    size_t dwords_in_page = dwords_to_read < (128 - page_offset) ? dwords_to_read : (128 - page_offset);
+bool ocp_ata_log_reader::read_pages(unsigned char logaddr, unsigned page,
+                                    void * data, unsigned nsectors)
+{
+  char *dest = (char *)data;
+
+  while (nsectors > 0) {
+    unsigned n = MIN(nsectors, m_max_sectors);
 
-    if (!ataReadLogExt(device, 0x24, 0, page_idx, page, 1)) {
+    if (n > 1) {
+      // Unlike ataReadLogExt(), do not fall back to single sectors for this
+      // request only.  Remember the reduced size for all further reads.
+      if (!ocp_read_log_ext(m_device, logaddr, page, dest, n)) {
+        unsigned max_sectors = 1;
+        while ((max_sectors << 1) < n)
+          max_sectors <<= 1;
+        m_max_sectors = max_sectors;
+        continue;
+      }
+    } else if (!ataReadLogExt(m_device, logaddr, 0, page, dest, 1)) {
       return false;
     }
 
-    memcpy(dest, (char *)(page + page_offset), dwords_in_page << 2);
-    dwords_to_read -= dwords_in_page;
+    page += n;
+    dest += n * 512;
+    nsectors -= n;
+  }
+
+  return true;
+}
+
+bool ocp_log_reader::read_dwords(unsigned char logaddr, unsigned first_page,
+                                 uint64_t start_dword, uint64_t size_dword,
+                                 void * data)
+{
+  char *dest = (char *)data;
+  unsigned page = first_page + (unsigned)(start_dword / 128);
+  unsigned page_offset = (unsigned)(start_dword % 128);
+
+  while (size_dword > 0) {
+    if (page_offset == 0 && size_dword >= 128) {
+      // Whole pages are transferred directly into the destination buffer
+      unsigned npages = (unsigned)MIN(size_dword / 128, (uint64_t)0xffff);
+      if (!read_pages(logaddr, page, dest, npages))
+        return false;
+      dest += npages * 512;
+      size_dword -= npages * 128;
+      page += npages;
+      continue;
+    }
+
+    // Partial first or last page
+    uint32_t buf[128];
+    unsigned dwords_in_page = (unsigned)MIN(size_dword, (uint64_t)(128 - page_offset));
+
+    if (!read_pages(logaddr, page, buf, 1))
+      return false;
+
+    memcpy(dest, buf + page_offset, dwords_in_page << 2);
     dest += dwords_in_page << 2;
-    ++page_idx;
+    size_dword -= dwords_in_page;
+    ++page;
     page_offset = 0;
   }
 
@@ -98,114 +450,690 @@ static bool read_ocp_telemetry_data_range_sata(ata_device * device,
 }
 
 ///////////////////////////////////////////////////////////////////////
-// Saved Device Internal Status log (Log 0x25)
+// Internal status parameter data of SCSI devices
 
-bool read_ata_ocp_telemetry_string_state(ata_device * device, unsigned nsectors,
-                                         struct ata_device_internal_status *internal_status,
-                                         struct ocp_telemetry_strings_header *ocp_strings_header,
-                                         ocp_string_def *string_def)
+#define OCP_SCSI_READ_BUFFER_MODE_ERROR_HISTORY 0x1c
+// Buffer ID to clear error history I_T nexus and release snapshot
+#define OCP_SCSI_ERROR_HISTORY_RELEASE_SNAPSHOT 0xff
+
+bool ocp_scsi_log_reader::read_directory()
 {
-  uint32_t log_page[128];
+  // Error history directory, SPC-5 section 6.20.2
+  uint8_t dir[32 + 8 * 64];
+  memset(dir, 0, sizeof dir);
+  int err = scsiReadBuffer(m_device, OCP_SCSI_READ_BUFFER_MODE_ERROR_HISTORY,
+                           0x00, 0, dir, sizeof dir);
+  if (err)
+    return m_device->set_err((err < 0 ? -err : EIO), "READ BUFFER error history directory failed");
+  m_snapshot = true;
+
+  unsigned dir_len = sg_get_unaligned_be16(dir + 30);
+  unsigned num_entries = MIN(dir_len, (unsigned)sizeof dir - 32) / 8;
+  for (unsigned i = 0; i < num_entries; i++) {
+    const uint8_t * entry = dir + 32 + 8 * i;
+    buffer_info * info;
+    switch (entry[1]) {
+      case OCP_SCSI_BUFFER_FORMAT_CURRENT: info = &m_current; break;
+      case OCP_SCSI_BUFFER_FORMAT_SAVED:   info = &m_saved; break;
+      default: continue;
+    }
+    info->buffer_id = entry[0];
+    info->num_sectors = (unsigned)MIN((sg_get_unaligned_be32(entry + 4) + 511ULL) / 512, 0x10000ULL);
+  }
+
+  if (m_current.buffer_id < 0 && m_saved.buffer_id < 0)
+    return m_device->set_err(ENOSYS, "No internal status parameter data in error history");
+  return true;
+}
+
+ocp_scsi_log_reader::~ocp_scsi_log_reader()
+{
+  if (!m_snapshot)
+    return;
+  // Keep error of last read
+  smart_device::error_info err = m_device->get_err();
+  release_snapshot();
+  m_device->set_err(err);
+}
+
+bool ocp_scsi_log_reader::release_snapshot()
+{
+  if (!m_snapshot)
+    return true;
+  m_snapshot = false;
+  m_current = m_saved = buffer_info();
+  // No data is transferred
+  int err = scsiReadBuffer(m_device, OCP_SCSI_READ_BUFFER_MODE_ERROR_HISTORY,
+                           OCP_SCSI_ERROR_HISTORY_RELEASE_SNAPSHOT, 0, nullptr, 0);
+  if (err)
+    return m_device->set_err((err < 0 ? -err : EIO), "READ BUFFER release error history snapshot failed");
+  return true;
+}
+
+const ocp_scsi_log_reader::buffer_info * ocp_scsi_log_reader::find_buffer(
+  unsigned char logaddr) const
+{
+  const buffer_info * info = (logaddr == 0x24 ? &m_current :
+                              logaddr == 0x25 ? &m_saved : nullptr);
+  return (info && info->buffer_id >= 0 ? info : nullptr);
+}
+
+unsigned ocp_scsi_log_reader::get_num_sectors(unsigned char logaddr) const
+{
+  const buffer_info * info = find_buffer(logaddr);
+  return (info ? info->num_sectors : 0);
+}
+
+bool ocp_scsi_log_reader::read_pages(unsigned char logaddr, unsigned page,
+                                     void * data, unsigned nsectors)
+{
+  const buffer_info * info = find_buffer(logaddr);
+  if (!info)
+    return m_device->set_err(ENOSYS, "Internal status parameter data not supported");
+
+  uint8_t *dest = (uint8_t *)data;
+  unsigned first_page = page;
+
+  while (nsectors > 0) {
+    unsigned n = MIN(nsectors, m_max_sectors);
+
+    int err = scsiReadBuffer(m_device, OCP_SCSI_READ_BUFFER_MODE_ERROR_HISTORY,
+                             info->buffer_id, (uint64_t)page * 512, dest, n * 512);
+    if (err) {
+      if (n > 1) {
+        // Remember the reduced size for all further reads, see ocp_ata_log_reader
+        unsigned max_sectors = 1;
+        while ((max_sectors << 1) < n)
+          max_sectors <<= 1;
+        m_max_sectors = max_sectors;
+        continue;
+      }
+      return m_device->set_err((err < 0 ? -err : EIO), "READ BUFFER error history failed");
+    }
+
+    page += n;
+    dest += n * 512;
+    nsectors -= n;
+  }
+
+  if (first_page == 0) {
+    // Internal status page, SPC-5 section 6.20.4: convert the big endian
+    // IEEE company id and data set lengths to the ATA layout.
+    struct ata_device_internal_status *status = (struct ata_device_internal_status *)data;
+    uint8_t *raw = (uint8_t *)data;
+    uint32_t org_id = sg_get_unaligned_be32(raw + 4);
+    uint16_t area1 = sg_get_unaligned_be16(raw + 8);
+    uint16_t area2 = sg_get_unaligned_be16(raw + 10);
+    uint16_t area3 = sg_get_unaligned_be16(raw + 12);
+    status->log_address = logaddr;
+    sg_put_unaligned_le32(org_id, &status->organization_id);
+    sg_put_unaligned_le16(area1, &status->area1_last_log_page);
+    sg_put_unaligned_le16(area2, &status->area2_last_log_page);
+    sg_put_unaligned_le16(area3, &status->area3_last_log_page);
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Capture of OCP telemetry log pages
+
+static const char ocp_capture_magic[8] = { 'O', 'C', 'P', 'T', 'L', 'C', 'A', 'P' };
+
+ocp_capture_log_reader::captured_log & ocp_capture_log_reader::get_log(unsigned char logaddr)
+{
+  for (captured_log & log : m_logs) {
+    if (log.logaddr == logaddr)
+      return log;
+  }
+  m_logs.push_back(captured_log());
+  m_logs.back().logaddr = logaddr;
+  return m_logs.back();
+}
+
+const ocp_capture_log_reader::captured_log * ocp_capture_log_reader::find_log(
+  unsigned char logaddr) const
+{
+  for (const captured_log & log : m_logs) {
+    if (log.logaddr == logaddr)
+      return &log;
+  }
+  return nullptr;
+}
+
+unsigned ocp_capture_log_reader::get_num_sectors(unsigned char logaddr) const
+{
+  const captured_log * log = find_log(logaddr);
+  return (log ? log->num_sectors : 0);
+}
 
-  if (!ataReadLogExt(device, 0x25, 0, 0, internal_status, 1)) {
+bool ocp_capture_log_reader::read_pages(unsigned char logaddr, unsigned page,
+                                        void * data, unsigned nsectors)
+{
+  if (m_source) {
+    if (!m_source->read_pages(logaddr, page, data, nsectors))
+      return false;
+    captured_log & log = get_log(logaddr);
+    if (log.present.size() < page + nsectors) {
+      log.present.resize(page + nsectors);
+      log.data.resize((page + nsectors) * 512);
+    }
+    memcpy(log.data.data() + page * 512, data, nsectors * 512);
+    for (unsigned i = 0; i < nsectors; i++)
+      log.present[page + i] = true;
+    return true;
+  }
+
+  const captured_log * log = find_log(logaddr);
+  if (!log || log->present.size() < page + nsectors)
     return false;
+  for (unsigned i = 0; i < nsectors; i++) {
+    if (!log->present[page + i])
+      return false;
   }
+  memcpy(data, log->data.data() + page * 512, nsectors * 512);
+  return true;
+}
 
-  if (internal_status->area1_last_log_page == 0) {
+static bool ocp_capture_write_le32(FILE * f, uint32_t val)
+{
+  uint8_t buf[4];
+  sg_put_unaligned_le32(val, buf);
+  return (fwrite(buf, 1, sizeof buf, f) == sizeof buf);
+}
+
+static bool ocp_capture_read_le32(FILE * f, uint32_t * val)
+{
+  uint8_t buf[4];
+  if (fread(buf, 1, sizeof buf, f) != sizeof buf)
+    return false;
+  *val = sg_get_unaligned_le32(buf);
+  return true;
+}
+
+bool ocp_capture_log_reader::save(const char * filename, std::string & errmsg) const
+{
+  stdio_file f(filename, "wb");
+  if (!f) {
+    errmsg = strprintf("%s: %s", filename, strerror(errno));
     return false;
   }
 
-  // The telemetry strings header is located on log page 1, starting
-  // at byte 0, and occupies the first 432 bytes. The remainder of the
-  // log page may contain string table entries.
-  if (!ataReadLogExt(device, 0x25, 0, 1, (void *)log_page, 1)) {
+  bool ok = (fwrite(ocp_capture_magic, 1, sizeof ocp_capture_magic, f) == sizeof ocp_capture_magic
+             && ocp_capture_write_le32(f, OCP_CAPTURE_VERSION)
+             && ocp_capture_write_le32(f, m_logs.size()));
+
+  for (const captured_log & log : m_logs) {
+    if (!ok)
+      break;
+    // Consecutive captured pages are saved as one run
+    std::vector<std::pair<unsigned, unsigned> > runs;
+    for (unsigned page = 0; page < log.present.size(); page++) {
+      if (!log.present[page])
+        continue;
+      if (!runs.empty() && runs.back().first + runs.back().second == page)
+        runs.back().second++;
+      else
+        runs.push_back(std::make_pair(page, 1U));
+    }
+
+    uint8_t hdr[4] = { log.logaddr, (uint8_t)(m_scsi ? 1 : 0), 0, 0 };
+    ok = (fwrite(hdr, 1, sizeof hdr, f) == sizeof hdr
+          && ocp_capture_write_le32(f, log.num_sectors)
+          && ocp_capture_write_le32(f, runs.size()));
+
+    for (const auto & run : runs) {
+      if (!ok)
+        break;
+      ok = (ocp_capture_write_le32(f, run.first)
+            && ocp_capture_write_le32(f, run.second)
+            && fwrite(log.data.data() + run.first * 512, 512, run.second, f) == run.second);
+    }
+  }
+
+  if (!f.close() || !ok) {
+    errmsg = strprintf("%s: Write error", filename);
+    return false;
+  }
+  return true;
+}
+
+bool ocp_capture_log_reader::load(const char * filename, std::string & errmsg)
+{
+  stdio_file f(filename, "rb");
+  if (!f) {
+    errmsg = strprintf("%s: %s", filename, strerror(errno));
     return false;
   }
-  *ocp_strings_header = *((struct ocp_telemetry_strings_header *)log_page);
 
-  // Any string data will immediately follow the header as the spec
-  // states that there can be no gaps between the tables. Also, the
-  // spec dictates that the stat id string table starts immediately
-  // following the header.
-  size_t dwords_to_read = ocp_strings_header->statistics_id_string_table_size +
-    ocp_strings_header->event_string_table_size +
-    ocp_strings_header->vu_event_string_table_size +
-    ocp_strings_header->ascii_table_size;
+  char magic[sizeof ocp_capture_magic];
+  uint32_t version = 0, num_logs = 0;
+  if (!(   fread(magic, 1, sizeof magic, f) == sizeof magic
+        && !memcmp(magic, ocp_capture_magic, sizeof magic)
+        && ocp_capture_read_le32(f, &version)
+        && ocp_capture_read_le32(f, &num_logs))) {
+    errmsg = strprintf("%s: Not an OCP telemetry capture file", filename);
+    return false;
+  }
+  if (version != OCP_CAPTURE_VERSION) {
+    errmsg = strprintf("%s: Unsupported capture file version %u", filename, version);
+    return false;
+  }
 
-  if (nsectors < (size_t)ceil((dwords_to_read + (sizeof *ocp_strings_header >> 2))/128) + 1) {
+  auto truncated = [&]() -> bool {
+    errmsg = strprintf("%s: Capture file is truncated", filename);
     return false;
+  };
+
+  m_logs.clear();
+  m_scsi = false;
+  for (uint32_t i = 0; i < num_logs; i++) {
+    uint8_t hdr[4];
+    uint32_t num_sectors = 0, num_runs = 0;
+    if (!(   fread(hdr, 1, sizeof hdr, f) == sizeof hdr
+          && ocp_capture_read_le32(f, &num_sectors)
+          && ocp_capture_read_le32(f, &num_runs)))
+      return truncated();
+
+    captured_log & log = get_log(hdr[0]);
+    log.num_sectors = num_sectors;
+    if (hdr[1] == 1)
+      m_scsi = true;
+
+    for (uint32_t j = 0; j < num_runs; j++) {
+      uint32_t first_page = 0, num_pages = 0;
+      if (!(   ocp_capture_read_le32(f, &first_page)
+            && ocp_capture_read_le32(f, &num_pages)))
+        return truncated();
+      // Pages of a GP log are addressed with 16 bits
+      if (!(first_page <= 0xffff && num_pages <= 0x10000 - first_page)) {
+        errmsg = strprintf("%s: Invalid page range in capture file", filename);
+        return false;
+      }
+      unsigned end = first_page + num_pages;
+      if (log.present.size() < end) {
+        log.present.resize(end);
+        log.data.resize(end * 512);
+      }
+      if (fread(log.data.data() + first_page * 512, 512, num_pages, f) != num_pages)
+        return truncated();
+      for (unsigned page = first_page; page < end; page++)
+        log.present[page] = true;
+    }
   }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Persistent cache of OCP string tables
+
+static const char ocp_string_cache_magic[8] = { 'O', 'C', 'P', 'S', 'T', 'R', 'C', '1' };
+const unsigned ocp_string_cache_header_size = 64 + 512;
+const unsigned ocp_string_cache_entry_size = 16;
 
-  if (ocp_strings_header->ascii_table_size > 0) {
-    string_def->ocp_string_ascii_table = (char *)malloc(ocp_strings_header->ascii_table_size << 2);
-    if (string_def->ocp_string_ascii_table == NULL) {
+// FNV-1a hash
+static uint64_t ocp_hash64(const uint8_t * data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Return name of temporary file used to replace FILENAME.  The PID keeps
+// processes which write the same file concurrently from sharing it.
+static std::string ocp_get_tmp_filename(const std::string & filename)
+{
+  return strprintf("%s.%d.tmp", filename.c_str(), (int)getpid());
+}
+
+ocp_string_cache::ocp_string_cache(const char * dir,
+                                   const uint8_t firmware_version[OCP_FIRMWARE_VERSION_LEN])
+: m_dir(dir)
+{
+  memcpy(m_firmware_version, firmware_version, sizeof m_firmware_version);
+}
+
+std::string ocp_string_cache::get_filename(const uint8_t * header_page) const
+{
+  const ocp_telemetry_strings_header * header = (const ocp_telemetry_strings_header *)header_page;
+  std::string name = m_dir + "/ocp-strings-";
+  for (int i = OCP_GUID_LEN - 1; i >= 0; i--)
+    name += strprintf("%02X", header->guid[i]);
+  name += '-';
+  // Firmware version is ASCII, keep only characters which are safe in file names
+  for (uint8_t c : m_firmware_version) {
+    if (('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z')
+        || c == '.' || c == '_' || c == '-')
+      name += (char)c;
+    else if (c != ' ' && c != 0)
+      name += strprintf("%%%02X", c);
+  }
+  name += strprintf("-%016" PRIx64 ".bin", ocp_hash64(header_page, 512));
+  return name;
+}
+
+static void ocp_put_string_entries(std::vector<uint8_t> & buf,
+                                   const std::vector<ocp_string_entry> & entries)
+{
+  for (const ocp_string_entry & e : entries) {
+    uint8_t raw[ocp_string_cache_entry_size];
+    sg_put_unaligned_le32(e.key, raw);
+    sg_put_unaligned_le32(e.len, raw + 4);
+    sg_put_unaligned_le64(e.offset, raw + 8);
+    buf.insert(buf.end(), raw, raw + sizeof raw);
+  }
+}
+
+static void ocp_get_string_entries(const uint8_t * raw, unsigned num,
+                                   std::vector<ocp_string_entry> & entries)
+{
+  entries.resize(num);
+  for (unsigned i = 0; i < num; i++, raw += ocp_string_cache_entry_size) {
+    entries[i].key = sg_get_unaligned_le32(raw);
+    entries[i].len = sg_get_unaligned_le32(raw + 4);
+    entries[i].offset = sg_get_unaligned_le64(raw + 8);
+  }
+}
+
+bool ocp_string_cache::load(const uint8_t * header_page, ocp_string_def * string_def)
+{
+  m_loaded = false;
+  std::string filename = get_filename(header_page);
+  stdio_file f(filename.c_str(), "rb");
+  if (!f)
+    return false;
+
+  uint8_t hdr[ocp_string_cache_header_size];
+  if (fread(hdr, 1, sizeof hdr, f) != sizeof hdr)
+    return false;
+  if (!(   !memcmp(hdr, ocp_string_cache_magic, sizeof ocp_string_cache_magic)
+        && sg_get_unaligned_le32(hdr + 8) == OCP_STRING_CACHE_VERSION
+        && !memcmp(hdr + 16, m_firmware_version, sizeof m_firmware_version)
+        && !memcmp(hdr + 64, header_page, 512)))
+    return false;
+
+  uint64_t content_hash = sg_get_unaligned_le64(hdr + 24);
+  unsigned num_stat = sg_get_unaligned_le32(hdr + 32);
+  unsigned num_event = sg_get_unaligned_le32(hdr + 36);
+  uint64_t area_size = sg_get_unaligned_le64(hdr + 40);
+  uint64_t ascii_offset = sg_get_unaligned_le64(hdr + 48);
+  uint64_t ascii_size = sg_get_unaligned_le64(hdr + 56);
+  // The string area consists of at most 64K log pages
+  if (!(   area_size >= 512 && area_size <= 0x10000ULL * 512
+        && ascii_offset <= area_size && ascii_size <= area_size - ascii_offset
+        && num_stat <= area_size / ocp_string_cache_entry_size
+        && num_event <= area_size / ocp_string_cache_entry_size))
+    return false;
+
+  std::vector<uint8_t> entries((size_t)(num_stat + num_event) * ocp_string_cache_entry_size);
+  std::vector<uint8_t> area((size_t)area_size);
+  if (!(   fread(entries.data(), 1, entries.size(), f) == entries.size()
+        && fread(area.data(), 1, area.size(), f) == area.size()
+        && ocp_hash64(area.data(), area.size()) == content_hash))
+    return false;
+
+  // All strings must be within the ASCII table
+  std::vector<ocp_string_entry> stat_strings, event_strings;
+  ocp_get_string_entries(entries.data(), num_stat, stat_strings);
+  ocp_get_string_entries(entries.data() + num_stat * ocp_string_cache_entry_size,
+                         num_event, event_strings);
+  for (const std::vector<ocp_string_entry> * v : { &stat_strings, &event_strings }) {
+    for (const ocp_string_entry & e : *v) {
+      if (!(e.offset <= ascii_size && e.len <= ascii_size - e.offset))
+        return false;
+    }
+  }
+
+  string_def->string_area.swap(area);
+  string_def->stat_id_strings.swap(stat_strings);
+  string_def->event_strings.swap(event_strings);
+  string_def->ascii_table_offset = (size_t)ascii_offset;
+  string_def->ascii_table_size = (size_t)ascii_size;
+  m_loaded = true;
+  return true;
+}
+
+bool ocp_string_cache::save(const ocp_string_def * string_def, std::string & errmsg) const
+{
+  const std::vector<uint8_t> & area = string_def->string_area;
+  if (area.size() < 512) {
+    errmsg = "No string tables";
+    return false;
+  }
+
+  std::vector<uint8_t> buf(ocp_string_cache_header_size);
+  uint8_t * hdr = buf.data();
+  memcpy(hdr, ocp_string_cache_magic, sizeof ocp_string_cache_magic);
+  sg_put_unaligned_le32(OCP_STRING_CACHE_VERSION, hdr + 8);
+  memcpy(hdr + 16, m_firmware_version, sizeof m_firmware_version);
+  sg_put_unaligned_le64(ocp_hash64(area.data(), area.size()), hdr + 24);
+  sg_put_unaligned_le32(string_def->stat_id_strings.size(), hdr + 32);
+  sg_put_unaligned_le32(string_def->event_strings.size(), hdr + 36);
+  sg_put_unaligned_le64(area.size(), hdr + 40);
+  sg_put_unaligned_le64(string_def->ascii_table_offset, hdr + 48);
+  sg_put_unaligned_le64(string_def->ascii_table_size, hdr + 56);
+  memcpy(hdr + 64, area.data(), 512);
+  ocp_put_string_entries(buf, string_def->stat_id_strings);
+  ocp_put_string_entries(buf, string_def->event_strings);
+
+  // Write to a temporary file first, concurrent readers never see a
+  // partial cache file
+  std::string filename = get_filename(area.data());
+  std::string tmpname = ocp_get_tmp_filename(filename);
+  stdio_file f(tmpname.c_str(), "wb");
+  if (!f) {
+    errmsg = strprintf("%s: %s", tmpname.c_str(), strerror(errno));
+    return false;
+  }
+  bool ok = (   fwrite(buf.data(), 1, buf.size(), f) == buf.size()
+             && fwrite(area.data(), 1, area.size(), f) == area.size());
+  if (!f.close() || !ok) {
+    errmsg = strprintf("%s: Write error", tmpname.c_str());
+    remove(tmpname.c_str());
+    return false;
+  }
+  if (rename(tmpname.c_str(), filename.c_str())) {
+    errmsg = strprintf("%s: %s", filename.c_str(), strerror(errno));
+    remove(tmpname.c_str());
+    return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Event FIFO cursors
+
+bool ocp_load_event_cursors(const char * filename, ocp_event_cursor cursors[2],
+                            std::string & errmsg)
+{
+  cursors[0] = cursors[1] = ocp_event_cursor();
+  stdio_file f(filename, "r");
+  if (!f) {
+    if (errno == ENOENT)
+      return true;
+    errmsg = strprintf("%s: %s", filename, strerror(errno));
+    return false;
+  }
+
+  ocp_event_cursor new_cursors[2];
+  char line[256];
+  for (int lineno = 1; fgets(line, sizeof(line), f); lineno++) {
+    const char * s = line + strspn(line, " \t");
+    if (!*s || *s == '#' || *s == '\n' || *s == '\r')
+      continue;
+    int fifo = 0, n = -1; char name[32] = ""; uint64_t val = 0;
+    if (!(   sscanf(s, "ocp-event-fifo.%d.%31[a-z-] = %" SCNu64 "%n", &fifo, name, &val, &n) == 3
+          && n > 0 && !s[n + strspn(s + n, " \t\r\n")] && (fifo == 1 || fifo == 2))) {
+      errmsg = strprintf("%s(%d): Syntax error", filename, lineno);
+      return false;
+    }
+    ocp_event_cursor & c = new_cursors[fifo - 1];
+    if (!strcmp(name, "end"))
+      c.end_dword = val;
+    else if (!strcmp(name, "tail-dwords") && val <= OCP_EVENT_CURSOR_TAIL_DWORDS)
+      c.tail_dwords = (uint32_t)val;
+    else if (!strcmp(name, "tail-hash"))
+      c.tail_hash = val;
+    else if (!strcmp(name, "timestamp"))
+      c.last_timestamp = val;
+    else {
+      errmsg = strprintf("%s(%d): Invalid value name or value", filename, lineno);
       return false;
     }
   }
 
-#define OCP_DO_STRING_TABLE_PROCESSING(_TABLE_NAME, _POS)       \
-   ocp_strings_header->_TABLE_NAME##_table_size > 0 &&           \
-   (_POS) >= ocp_strings_header->_TABLE_NAME##_table_start && \
-   (_POS) < ocp_strings_header->_TABLE_NAME##_table_start + \
-               ocp_strings_header->_TABLE_NAME##_table_size
-#define OCP_STRING_TABLE_BYTES_IN_PAGE(_TABLE_NAME, _LEN)     \
-    (dword_pos + (_LEN) < ocp_strings_header->_TABLE_NAME##_table_start + \
-                    ocp_strings_header->_TABLE_NAME##_table_size  ? \
-     (_LEN) : ocp_strings_header->_TABLE_NAME##_table_start +  \
-     ocp_strings_header->_TABLE_NAME##_table_size - dword_pos)
-
-  size_t dword_pos = sizeof *ocp_strings_header >> 2;
-  size_t dwords_in_page = 128 - (sizeof *ocp_strings_header >> 2);
-  unsigned int log_page_idx = 1;
-  uint8_t *log_page_pos = (uint8_t *)log_page + sizeof *ocp_strings_header;
-  size_t dwords_consumed = 0;
-  size_t ascii_offset = 0;
-
-  while (dwords_to_read > 0) {
-    if (OCP_DO_STRING_TABLE_PROCESSING(statistics_id_string, dword_pos)) {
-      dwords_consumed = OCP_STRING_TABLE_BYTES_IN_PAGE(statistics_id_string, dwords_in_page);
-      ocp_process_stat_id_strings(log_page_pos, dwords_consumed << 2, string_def);
-    } else if (OCP_DO_STRING_TABLE_PROCESSING(event_string, dword_pos)) {
-      dwords_consumed = OCP_STRING_TABLE_BYTES_IN_PAGE(event_string, dwords_in_page);
-      ocp_process_event_strings(log_page_pos, dwords_consumed << 2, string_def);
-    } else if (OCP_DO_STRING_TABLE_PROCESSING(vu_event_string, dword_pos)) {
-      dwords_consumed = OCP_STRING_TABLE_BYTES_IN_PAGE(vu_event_string, dwords_in_page);
-      ocp_process_event_strings(log_page_pos, dwords_consumed << 2, string_def);
-    } else if (OCP_DO_STRING_TABLE_PROCESSING(ascii, dword_pos)) {
-      dwords_consumed = OCP_STRING_TABLE_BYTES_IN_PAGE(ascii, dwords_in_page);
-      memcpy(&string_def->ocp_string_ascii_table[ascii_offset], log_page_pos,
-             dwords_consumed << 2);
-      ascii_offset += dwords_consumed << 2;
-    } else {
-      printf("Ran out of space before all dwords were read\n");
-      break;
+  for (const ocp_event_cursor & c : new_cursors) {
+    if (c.tail_dwords > c.end_dword) {
+      errmsg = strprintf("%s: Inconsistent cursor", filename);
+      return false;
     }
-    dword_pos += dwords_consumed;
-    log_page_pos += dwords_consumed << 2;
-    dwords_to_read -= dwords_consumed;
-    dwords_in_page -= dwords_consumed;
-    if (dwords_in_page > 0)
+  }
+  cursors[0] = new_cursors[0]; cursors[1] = new_cursors[1];
+  return true;
+}
+
+bool ocp_save_event_cursors(const char * filename, const ocp_event_cursor cursors[2],
+                            std::string & errmsg)
+{
+  std::string tmpname = ocp_get_tmp_filename(filename);
+  stdio_file f(tmpname.c_str(), "w");
+  if (!f) {
+    errmsg = strprintf("%s: %s", tmpname.c_str(), strerror(errno));
+    return false;
+  }
+
+  fprintf(f, "# OCP telemetry event FIFO cursors\n");
+  for (int i = 0; i < 2; i++) {
+    const ocp_event_cursor & c = cursors[i];
+    if (!c.valid())
       continue;
+    fprintf(f, "ocp-event-fifo.%d.end = %" PRIu64 "\n", i + 1, c.end_dword);
+    fprintf(f, "ocp-event-fifo.%d.tail-dwords = %u\n", i + 1, c.tail_dwords);
+    fprintf(f, "ocp-event-fifo.%d.tail-hash = %" PRIu64 "\n", i + 1, c.tail_hash);
+    fprintf(f, "ocp-event-fifo.%d.timestamp = %" PRIu64 "\n", i + 1, c.last_timestamp);
+  }
+
+  if (!f.close()) {
+    errmsg = strprintf("%s: Write error", tmpname.c_str());
+    remove(tmpname.c_str());
+    return false;
+  }
+  if (rename(tmpname.c_str(), filename)) {
+    errmsg = strprintf("%s: %s", filename, strerror(errno));
+    remove(tmpname.c_str());
+    return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Saved Device Internal Status log (Log 0x25)
+
+static bool validate_ocp_telemetry_strings_header(const struct ocp_telemetry_strings_header *header,
+                                                  unsigned nsectors, uint64_t *end_dword)
+{
+  // All tables must fit into the log pages following the internal status
+  // page, must not overlap the header or each other, and the id tables
+  // must contain whole entries.
+  uint64_t max_dword = (uint64_t)(nsectors - 1) * 128;
+  const uint64_t tables[][3] = {
+    { header->statistics_id_string_table_start, header->statistics_id_string_table_size,
+      sizeof(ocp_statistic_id_string_table_entry) >> 2 },
+    { header->event_string_table_start, header->event_string_table_size,
+      sizeof(ocp_event_id_string_table_entry) >> 2 },
+    { header->vu_event_string_table_start, header->vu_event_string_table_size,
+      sizeof(ocp_event_id_string_table_entry) >> 2 },
+    { header->ascii_table_start, header->ascii_table_size, 1 },
+  };
+  const unsigned num_tables = sizeof tables / sizeof tables[0];
 
-    if (dwords_to_read > 0) {
-      dwords_in_page = MIN(dwords_to_read, 128);
-      ++log_page_idx;
-      log_page_pos = (uint8_t *)log_page;
-      if (!ataReadLogExt(device, 0x25, 0, log_page_idx, (void *)log_page, 1)) {
+  *end_dword = sizeof *header >> 2;
+  for (unsigned i = 0; i < num_tables; i++) {
+    uint64_t start = tables[i][0], size = tables[i][1];
+    if (!size)
+      continue;
+    if (start < (sizeof *header >> 2) || start > max_dword || size > max_dword - start)
+      return false;
+    if (size % tables[i][2])
+      return false;
+    for (unsigned j = 0; j < i; j++) {
+      if (tables[j][1] && start < tables[j][0] + tables[j][1] && tables[j][0] < start + size)
         return false;
-      }
+    }
+    if (start + size > *end_dword)
+      *end_dword = start + size;
+  }
+
+  return true;
+}
+
+// Copy a space padded FIFO name without trailing spaces.
+static void ocp_fifo_name_to_str(const uint8_t * name, char * str)
+{
+  size_t len = OCP_FIFO_NAME_LEN;
+  while (len > 0 && (name[len - 1] == ' ' || !name[len - 1]))
+    len--;
+  memcpy(str, name, len);
+  str[len] = 0;
+}
+
+bool read_ata_ocp_telemetry_string_state(ocp_log_reader & reader, unsigned nsectors,
+                                         struct ata_device_internal_status *internal_status,
+                                         struct ocp_telemetry_strings_header *ocp_strings_header,
+                                         ocp_string_def *string_def,
+                                         ocp_string_cache *cache /* = nullptr */)
+{
+  if (!reader.read_pages(0x25, 0, internal_status, 1)) {
+    return false;
+  }
+
+  if (internal_status->area1_last_log_page == 0) {
+    return false;
+  }
+
+  // The telemetry strings header is located on log page 1, starting
+  // at byte 0, and occupies the first 432 bytes. The remainder of the
+  // log page may contain string table entries.
+  std::vector<uint8_t> & area = string_def->string_area;
+  area.assign(512, 0);
+  if (!reader.read_pages(0x25, 1, area.data(), 1)) {
+    return false;
+  }
+  *ocp_strings_header = *((struct ocp_telemetry_strings_header *)area.data());
+  ocp_fifo_name_to_str(ocp_strings_header->event_fifo_1_name, string_def->event_fifo_1_name);
+  ocp_fifo_name_to_str(ocp_strings_header->event_fifo_2_name, string_def->event_fifo_2_name);
+
+  // Table offsets are dwords relative to byte 0 of the header.  Check all
+  // of them before anything is read, then read the remaining pages of the
+  // string area with as few commands as possible.
+  uint64_t end_dword;
+  if (!validate_ocp_telemetry_strings_header(ocp_strings_header, nsectors, &end_dword)) {
+    return false;
+  }
+
+  // Only the header page is needed if the tables are cached
+  if (cache && cache->load(area.data(), string_def))
+    return true;
+
+  unsigned npages = (unsigned)((end_dword + 127) / 128);
+  if (npages > 1) {
+    area.resize((size_t)npages * 512);
+    if (!reader.read_pages(0x25, 2, area.data() + 512, npages - 1)) {
+      return false;
     }
   }
 
+  ocp_process_string_tables(ocp_strings_header, string_def);
   return true;
 }
 
-bool read_ata_ocp_telemetry_statistics(ata_device * device, unsigned nsectors,
-                                       struct ata_device_internal_status *internal_status,
-                                       struct ocp_telemetry_data_header *ocp_data_header,
-                                       char **stats)
+bool read_ata_ocp_telemetry_data_header(ocp_log_reader & reader, unsigned nsectors,
+                                        struct ata_device_internal_status *internal_status,
+                                        struct ocp_telemetry_data_header *ocp_data_header)
 {
-  if (!ataReadLogExt(device, 0x24, 0, 0, internal_status, 1)) {
+  if (!reader.read_pages(0x24, 0, internal_status, 1)) {
     return false;
   }
 
@@ -226,61 +1154,479 @@ bool read_ata_ocp_telemetry_statistics(ata_device * device, unsigned nsectors,
   }
 
   // area1 starts at log page 1
-  if (!ataReadLogExt(device, 0x24, 0, 1, ocp_data_header, 1)) {
+  if (!reader.read_pages(0x24, 1, ocp_data_header, 1)) {
     return false;
   }
 
-  if (!validate_ocp_telemetry_data_header(ocp_data_header, nsectors))
-    return false;
+  return validate_ocp_telemetry_data_header(ocp_data_header, nsectors);
+}
 
-  size_t log_size = (ocp_data_header->statistic1_size_dword +
-                     ocp_data_header->statistic2_size_dword +
-                     ocp_data_header->event1_FIFO_size_dword +
-                     ocp_data_header->event2_FIFO_size_dword) << 2;
+///////////////////////////////////////////////////////////////////////
+// Parse session
 
-  char *logs = (char *)malloc(log_size);
-  if (logs == NULL) {
+ocp_arena::~ocp_arena()
+{
+  for (const block & b : m_blocks)
+    delete [] b.data;
+}
+
+void * ocp_arena::alloc(size_t size)
+{
+  size = (size + 7) & ~(size_t)7;
+  // Use the remainder of the current block or the next free one
+  for (; m_cur < m_blocks.size(); m_cur++, m_pos = 0) {
+    const block & b = m_blocks[m_cur];
+    if (size <= b.size - m_pos) {
+      void * p = b.data + m_pos;
+      m_pos += size;
+      m_used += size;
+      return p;
+    }
+  }
+
+  // Large requests get a block of their own
+  block b;
+  b.size = std::max(size, m_block_size);
+  b.data = new uint8_t[b.size];
+  m_blocks.push_back(b);
+  m_cur = m_blocks.size() - 1;
+  m_pos = size;
+  m_used += size;
+  return b.data;
+}
+
+void ocp_telemetry_session::reset()
+{
+  strings_status = ata_device_internal_status();
+  strings_header = ocp_telemetry_strings_header();
+  string_def = ocp_string_def();
+  data_status = ata_device_internal_status();
+  data_header = ocp_telemetry_data_header();
+  for (area & a : statistic_areas)
+    a = area();
+  for (area & a : event_fifos)
+    a = area();
+  m_arena.reset();
+}
+
+bool ocp_telemetry_session::read_strings(ocp_log_reader & reader, unsigned nsectors,
+                                         ocp_string_cache * cache /* = nullptr */)
+{
+  return read_ata_ocp_telemetry_string_state(reader, nsectors, &strings_status, &strings_header,
+                                             &string_def, cache);
+}
+
+bool ocp_telemetry_session::read_data_header(ocp_log_reader & reader, unsigned nsectors)
+{
+  return read_ata_ocp_telemetry_data_header(reader, nsectors, &data_status, &data_header);
+}
+
+bool ocp_telemetry_session::read_data(ocp_log_reader & reader, unsigned nsectors)
+{
+  return read_areas(reader, nsectors, 4);
+}
+
+bool ocp_telemetry_session::read_statistics(ocp_log_reader & reader, unsigned nsectors)
+{
+  return read_areas(reader, nsectors, 2);
+}
+
+// Read the data header and the first NUM_AREAS areas: statistic areas 1, 2
+// and event FIFOs 1, 2.
+bool ocp_telemetry_session::read_areas(ocp_log_reader & reader, unsigned nsectors, int num_areas)
+{
+  if (!read_data_header(reader, nsectors))
     return false;
+
+  const uint64_t areas[4][2] = {
+    { data_header.statistic1_start_dword, data_header.statistic1_size_dword },
+    { data_header.statistic2_start_dword, data_header.statistic2_size_dword },
+    { data_header.event1_FIFO_start_dword, data_header.event1_FIFO_size_dword },
+    { data_header.event2_FIFO_start_dword, data_header.event2_FIFO_size_dword },
+  };
+  area * dest[4] = { &statistic_areas[0], &statistic_areas[1], &event_fifos[0], &event_fifos[1] };
+
+  for (int i = 0; i < 4; i++) {
+    *dest[i] = area();
+    if (!(i < num_areas && areas[i][1]))
+      continue;
+    // Size is checked by validate_ocp_telemetry_data_header()
+    uint8_t * data = (uint8_t *)m_arena.alloc((size_t)areas[i][1] << 2);
+    if (!reader.read_dwords(0x24, 1, areas[i][0], areas[i][1], data))
+      return false;
+    dest[i]->data = data;
+    dest[i]->dwords = (size_t)areas[i][1];
   }
+  return true;
+}
+
+
+// Part of an event FIFO read into memory, covers dwords
+// [start, start + data.size()/4) relative to the FIFO start.
+struct ocp_event_fifo_buffer {
+  std::vector<uint8_t> data;
+  uint64_t start = 0;
+
+  uint64_t end() const
+    { return start + (data.size() >> 2); }
+};
+
+// Return end offset of the events starting at OFFSET in BUF.
+// Set *TRUNCATED if the last event does not fit into BUF.
+static size_t ocp_event_fifo_parse(const ocp_event_fifo_buffer & buf, size_t offset,
+                                   bool * truncated)
+{
+  ocp_event_desc_range descs(buf.data.data() + offset, (buf.data.size() - offset) >> 2);
+  size_t end = offset;
+  ocp_event_desc_range::iterator it;
+  for (it = descs.begin(); it != descs.end(); ++it)
+    end = (it.pos() - buf.data.data()) + sizeof(ocp_event_descriptor) + it->data_size();
+  *truncated = it.truncated();
+  return end;
+}
+
+// Check whether the events which follow the cursor position could start at
+// byte offset POS of BUF.
+static bool ocp_event_cursor_matches(const ocp_event_cursor * cursor,
+                                     const ocp_event_fifo_buffer & buf, size_t pos)
+{
+  size_t tail_size = (size_t)cursor->tail_dwords << 2;
+  return (   pos >= tail_size
+          && ocp_hash64(buf.data.data() + pos - tail_size, tail_size) == cursor->tail_hash);
+}
+
+bool read_ata_ocp_telemetry_new_events(ocp_log_reader & reader,
+                                       const struct ocp_telemetry_data_header *ocp_data_header,
+                                       int fifo_num, ocp_event_cursor * cursor,
+                                       std::vector<uint8_t> & events, bool * lost)
+{
+  uint64_t fifo_start = (fifo_num == 1 ? ocp_data_header->event1_FIFO_start_dword
+                                       : ocp_data_header->event2_FIFO_start_dword);
+  uint64_t fifo_size  = (fifo_num == 1 ? ocp_data_header->event1_FIFO_size_dword
+                                       : ocp_data_header->event2_FIFO_size_dword);
+  events.clear();
+  *lost = false;
 
-  size_t bytes_read = 0;
-  if (ocp_data_header->statistic1_size_dword > 0) {
-    if (!read_ocp_telemetry_data_range_sata(device, ocp_data_header->statistic1_start_dword,
-                                            ocp_data_header->statistic1_size_dword,
-                                            logs)) {
-      goto read_error;
+  // Read dwords [FROM, TO) of the FIFO into BUF, before or after the existing data
+  auto read_fifo = [&](ocp_event_fifo_buffer & buf, uint64_t from, uint64_t to) -> bool {
+    std::vector<uint8_t> data((size_t)(to - from) << 2);
+    if (!reader.read_dwords(0x24, 1, fifo_start + from, to - from, data.data()))
+      return false;
+    if (buf.data.empty() || from < buf.start) {
+      data.insert(data.end(), buf.data.begin(), buf.data.end());
+      buf.data.swap(data);
+      buf.start = from;
     }
-    bytes_read += ocp_data_header->statistic1_size_dword << 2;
-  }
-  if (ocp_data_header->statistic2_size_dword > 0) {
-    if (!read_ocp_telemetry_data_range_sata(device, ocp_data_header->statistic2_start_dword,
-                                            ocp_data_header->statistic2_size_dword,
-                                            &logs[bytes_read])) {
-      goto read_error;
+    else
+      buf.data.insert(buf.data.end(), data.begin(), data.end());
+    return true;
+  };
+
+  ocp_event_fifo_buffer buf;
+  size_t pos = 0, end = 0;
+  bool found = false;
+  uint64_t chunk = 128;
+
+  if (cursor->valid() && cursor->end_dword <= fifo_size) {
+    // Read forward from the old position until the end of the FIFO or
+    // the end marker is reached
+    uint64_t from = cursor->end_dword - cursor->tail_dwords;
+    if (!read_fifo(buf, from, std::min(fifo_size, cursor->end_dword + chunk)))
+      return false;
+    pos = (size_t)cursor->tail_dwords << 2;
+    if (ocp_event_cursor_matches(cursor, buf, pos)) {
+      found = true;
+      for (;;) {
+        bool truncated;
+        end = ocp_event_fifo_parse(buf, pos, &truncated);
+        if (!((truncated || end == buf.data.size()) && buf.end() < fifo_size))
+          break;
+        chunk <<= 1;
+        if (!read_fifo(buf, buf.end(), std::min(fifo_size, buf.end() + chunk)))
+          return false;
+      }
     }
-    bytes_read += ocp_data_header->statistic2_size_dword << 2;
   }
-  if (ocp_data_header->event1_FIFO_size_dword > 0) {
-    if (!read_ocp_telemetry_data_range_sata(device, ocp_data_header->event1_FIFO_start_dword,
-                                            ocp_data_header->event1_FIFO_size_dword,
-                                            &logs[bytes_read])) {
-      goto read_error;
+
+  if (!found && cursor->valid()) {
+    // Older events were dropped, search the old position backwards from the
+    // end of the FIFO.  The reads are aligned to log pages.
+    buf = ocp_event_fifo_buffer();
+    buf.start = fifo_size;
+    chunk = 128;
+    while (!found && buf.start > 0) {
+      uint64_t old_start = buf.start;
+      uint64_t from = (old_start > chunk ? old_start - chunk : 0);
+      from -= std::min(from, (fifo_start + from) % 128);
+      if (!read_fifo(buf, from, old_start))
+        return false;
+      chunk <<= 1;
+
+      // Check the positions which are now preceded by a complete tail
+      uint64_t first = buf.start + cursor->tail_dwords;
+      uint64_t last = std::min(old_start + cursor->tail_dwords - 1, fifo_size);
+      for (uint64_t p = last; p >= first && p > 0 && !found; p--) {
+        size_t offset = (size_t)(p - buf.start) << 2;
+        if (!ocp_event_cursor_matches(cursor, buf, offset))
+          continue;
+        bool truncated;
+        size_t e = ocp_event_fifo_parse(buf, offset, &truncated);
+        if (!truncated) {
+          found = true;
+          pos = offset; end = e;
+        }
+      }
     }
-    bytes_read += ocp_data_header->event1_FIFO_size_dword << 2;
   }
-  if (ocp_data_header->event2_FIFO_size_dword > 0) {
-    if (!read_ocp_telemetry_data_range_sata(device, ocp_data_header->event2_FIFO_start_dword,
-                                            ocp_data_header->event2_FIFO_size_dword,
-                                            &logs[bytes_read])) {
-      goto read_error;
+
+  if (!found) {
+    // No or unknown position, return the complete FIFO
+    *lost = cursor->valid();
+    if (buf.start > 0 || buf.end() < fifo_size) {
+      buf = ocp_event_fifo_buffer();
+      if (fifo_size > 0 && !read_fifo(buf, 0, fifo_size))
+        return false;
     }
+    bool truncated;
+    pos = 0;
+    end = ocp_event_fifo_parse(buf, 0, &truncated);
+  }
+
+  events.assign(buf.data.begin() + pos, buf.data.begin() + end);
+
+  // Advance cursor to the end of the newest event
+  ocp_event_cursor new_cursor;
+  new_cursor.end_dword = buf.start + (end >> 2);
+  new_cursor.tail_dwords = (uint32_t)std::min((uint64_t)OCP_EVENT_CURSOR_TAIL_DWORDS,
+                                              (uint64_t)(end >> 2));
+  new_cursor.tail_hash = ocp_hash64(buf.data.data() + end - ((size_t)new_cursor.tail_dwords << 2),
+                                    (size_t)new_cursor.tail_dwords << 2);
+  new_cursor.last_timestamp = (found ? cursor->last_timestamp : 0);
+  for (const ocp_event_desc_view & ev : ocp_event_desc_range(events.data(), events.size() >> 2)) {
+    uint64_t timestamp;
+    if (ev.get_timestamp(&timestamp))
+      new_cursor.last_timestamp = timestamp;
   }
-  *stats = logs;
+  *cursor = new_cursor;
   return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Event timeline
+
+// Timestamp events contain milliseconds in the lower 48 bits, the
+// upper 16 bits are timestamp info.
+#define OCP_TIMESTAMP_MSECS_MASK 0xffffffffffffULL
+
+static bool ocp_timeline_less(const ocp_timeline_event & e1, const ocp_timeline_event & e2)
+{
+  if (e1.time_valid != e2.time_valid)
+    return !e1.time_valid;
+  if (e1.time != e2.time)
+    return e1.time < e2.time;
+  if (e1.fifo != e2.fifo)
+    return e1.fifo < e2.fifo;
+  return e1.index < e2.index;
+}
+
+// Return true if event E is before TIME.
+static bool ocp_timeline_before(const ocp_timeline_event & e, uint64_t time)
+{
+  return (!e.time_valid || e.time < time);
+}
 
-read_error:
-  free(logs);
-  return false;
+bool ocp_event_timeline::add_fifo(int fifo_num, const void * data, size_t dwords,
+                                  const uint64_t * start_time /* = nullptr */)
+{
+  bool time_valid = !!start_time;
+  uint64_t time = (start_time ? *start_time & OCP_TIMESTAMP_MSECS_MASK : 0);
+  unsigned index = 0;
+
+  ocp_event_desc_range descs(data, dwords);
+  ocp_event_desc_range::iterator it;
+  for (it = descs.begin(); it != descs.end(); ++it, index++) {
+    uint64_t timestamp;
+    if (it->get_timestamp(&timestamp)) {
+      time = timestamp & OCP_TIMESTAMP_MSECS_MASK;
+      time_valid = true;
+    }
+    ocp_timeline_event e;
+    e.desc = *it;
+    e.time = time;
+    e.time_valid = time_valid;
+    e.fifo = (uint8_t)fifo_num;
+    e.index = index;
+    m_events.push_back(e);
+  }
+
+  std::sort(m_events.begin(), m_events.end(), ocp_timeline_less);
+  build_index();
+  return !it.truncated();
+}
+
+void ocp_event_timeline::clear()
+{
+  m_events.clear();
+  m_class_index.clear();
+}
+
+void ocp_event_timeline::build_index()
+{
+  m_class_index.clear();
+  for (unsigned i = 0; i < m_events.size(); i++) {
+    uint8_t class_type = m_events[i].desc.class_type();
+    if (class_type >= m_class_index.size())
+      m_class_index.resize(class_type + 1);
+    m_class_index[class_type].push_back(i);
+  }
+}
+
+std::pair<ocp_event_timeline::const_iterator, ocp_event_timeline::const_iterator>
+ocp_event_timeline::time_range(uint64_t from, uint64_t to) const
+{
+  const_iterator first = std::lower_bound(m_events.begin(), m_events.end(), from,
+                                          ocp_timeline_before);
+  if (to < from)
+    to = from;
+  return std::make_pair(first, std::lower_bound(first, m_events.end(), to,
+                                                ocp_timeline_before));
+}
+
+void ocp_event_timeline::find(uint8_t class_type, uint64_t from, uint64_t to,
+                              std::vector<const ocp_timeline_event *> & result) const
+{
+  if (class_type >= m_class_index.size())
+    return;
+  const std::vector<unsigned> & index = m_class_index[class_type];
+  auto before = [this](unsigned i, uint64_t time) {
+    return ocp_timeline_before(m_events[i], time);
+  };
+  for (auto it = std::lower_bound(index.begin(), index.end(), from, before);
+       it != index.end() && m_events[*it].time < to; ++it)
+    result.push_back(&m_events[*it]);
+}
+
+uint64_t ocp_event_timeline::last_time() const
+{
+  if (m_events.empty() || !m_events.back().time_valid)
+    return 0;
+  return m_events.back().time;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Statistic deltas
+
+bool ocp_stat_is_counter(uint8_t behavior_type, uint8_t unit)
+{
+  switch (unit) {
+    case OCP_UNIT_TYPE_C: case OCP_UNIT_TYPE_K: case OCP_UNIT_TYPE_F:
+    case OCP_UNIT_TYPE_MV: case OCP_UNIT_TYPE_MA: case OCP_UNIT_TYPE_OHM:
+    case OCP_UNIT_TYPE_RPM:
+      return false; // Gauge
+  }
+  switch (behavior_type) {
+    case OCP_BEHV_TYPE_SC_R: case OCP_BEHV_TYPE_SC_R_PC: case OCP_BEHV_TYPE_SC:
+      return true;
+    default: // Persistent values (e.g. lifetime maximum), N/A, runtime value or reserved
+      return false;
+  }
+}
+
+ocp_stat_delta_status ocp_stat_delta(uint8_t behavior_type, size_t data_size,
+                                     uint64_t old_val, uint64_t new_val, uint64_t * delta)
+{
+  bool power_cycle_resistent;
+  switch (behavior_type) {
+    case OCP_BEHV_TYPE_SC_R:    power_cycle_resistent = false; break;
+    case OCP_BEHV_TYPE_SC_R_PC: power_cycle_resistent = true; break;
+    case OCP_BEHV_TYPE_SC:      power_cycle_resistent = false; break;
+    default: // Persistent values, N/A, runtime value or reserved
+      return OCP_DELTA_NO_COUNTER;
+  }
+
+  uint64_t max_val = (data_size < 8 ? (1ULL << (data_size * 8)) - 1 : ~0ULL);
+  if (old_val >= max_val)
+    return OCP_DELTA_UNKNOWN;
+
+  if (new_val < old_val) {
+    // A counter which is not power cycle resistent starts again at 0,
+    // any other decrease is unexpected.
+    if (!power_cycle_resistent) {
+      *delta = new_val;
+      return OCP_DELTA_RESET;
+    }
+    return OCP_DELTA_UNKNOWN;
+  }
+
+  *delta = new_val - old_val;
+  if (new_val >= max_val)
+    return OCP_DELTA_SATURATED;
+  return OCP_DELTA_OK;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Statistic time series
+
+static bool ocp_series_id_less(const ocp_stat_time_series::series & s, uint16_t id)
+{
+  return s.id < id;
+}
+
+unsigned ocp_stat_time_series::add(const ocp_event_timeline & timeline)
+{
+  unsigned cnt = 0;
+  // Timeline is in time order, so samples are appended in time order
+  for (const ocp_timeline_event & e : timeline.events()) {
+    if (!e.time_valid)
+      continue;
+    ocp_stat_desc_view sv = e.desc.stat_snapshot();
+    if (!sv.valid())
+      continue;
+
+    uint64_t val;
+    uint8_t data_type = sv.data_type();
+    if (data_type == OCP_DATA_TYPE_UINT) {
+      if (!sv.get_uint(&val))
+        continue;
+    }
+    else if (data_type == OCP_DATA_TYPE_INT) {
+      int64_t ival;
+      if (!sv.get_int(&ival))
+        continue;
+      val = (uint64_t)ival;
+    }
+    else
+      continue;
+
+    uint16_t id = sv.id();
+    auto it = std::lower_bound(m_series.begin(), m_series.end(), id, ocp_series_id_less);
+    if (it == m_series.end() || it->id != id) {
+      series s;
+      s.id = id;
+      s.data_type = data_type;
+      s.behavior_type = sv.behavior_type();
+      s.unit = sv.unit();
+      it = m_series.insert(it, s);
+    }
+    else if (it->data_type != data_type)
+      continue;
+    // Samples of a later add() may be older
+    size_t pos = std::upper_bound(it->times.begin(), it->times.end(), e.time) - it->times.begin();
+    it->times.insert(it->times.begin() + pos, e.time);
+    it->values.insert(it->values.begin() + pos, val);
+    cnt++;
+  }
+  return cnt;
+}
+
+const ocp_stat_time_series::series * ocp_stat_time_series::find(uint16_t id) const
+{
+  auto it = std::lower_bound(m_series.begin(), m_series.end(), id, ocp_series_id_less);
+  if (it == m_series.end() || it->id != id)
+    return nullptr;
+  return &*it;
 }
 
 } // namespace smartmon
@@ -1552,6 +1552,49 @@ scsiReadDefect12(scsi_device * device, int req_plist, int req_glist,
     return scsiSimpleSenseFilter(&sinfo);
 }
 
+/* READ BUFFER command. Uses READ BUFFER (10) if offset and length fit
+ * into its 24 bit fields, otherwise READ BUFFER (16). Returns 0 if ok, 1
+ * if NOT READY, 2 if command not supported, 3 if field in command not
+ * supported or returns negated errno. SPC-5 sections 6.19 and 6.20 */
+int
+scsiReadBuffer(scsi_device * device, int mode, int buffer_id,
+               uint64_t offset, uint8_t *pBuf, int bufLen)
+{
+    struct scsi_cmnd_io io_hdr = {};
+    struct scsi_sense_disect sinfo;
+    uint8_t cdb[16] = {};
+    uint8_t sense[32];
+
+    if ((bufLen < 0) || (mode & ~0x1f))
+        return -EINVAL;
+    io_hdr.dxfer_dir = DXFER_FROM_DEVICE;
+    io_hdr.dxfer_len = bufLen;
+    io_hdr.dxferp = pBuf;
+    if ((offset <= 0xffffff) && (bufLen <= 0xffffff)) {
+        cdb[0] = READ_BUFFER_10;
+        cdb[1] = (uint8_t)mode;
+        cdb[2] = (uint8_t)buffer_id;
+        sg_put_unaligned_be24((uint32_t)offset, cdb + 3);
+        sg_put_unaligned_be24(bufLen, cdb + 6);
+        io_hdr.cmnd_len = 10;
+    } else {
+        cdb[0] = READ_BUFFER_16;
+        cdb[1] = (uint8_t)mode;
+        sg_put_unaligned_be64(offset, cdb + 2);
+        sg_put_unaligned_be32(bufLen, cdb + 10);
+        cdb[14] = (uint8_t)buffer_id;
+        io_hdr.cmnd_len = 16;
+    }
+    io_hdr.cmnd = cdb;
+    io_hdr.sensep = sense;
+    io_hdr.max_sense_len = sizeof(sense);
+    io_hdr.timeout = SCSI_TIMEOUT_DEFAULT;
+
+    if (! scsi_pass_through_yield_sense(device, &io_hdr, sinfo))
+      return -device->get_errno();
+    return scsiSimpleSenseFilter(&sinfo);
+}
+
 /* Call scsi_pass_through, and retry only if a UNIT_ATTENTION (UA) is raised.
  * When false returned, the caller should invoke device->get_error().
  * When true returned, the caller should check sinfo.
@@ -2476,6 +2476,7 @@ static int PrintSmartExtErrorLog(ata_device * device,
   // Recently read log page
   ata_smart_exterrlog log_buf;
   unsigned log_buf_page = ~0;
+  json::ref jref_table = jref["table"].stream();
 
   // Iterate through circular buffer in reverse direction
   for (unsigned i = 0, errnum = log->device_error_count;
@@ -2498,7 +2499,7 @@ static int PrintSmartExtErrorLog(ata_device * device,
 
     const ata_smart_exterrlog_error_log & entry = log_p->error_logs[erridx % 4];
 
-    json::ref jrefi = jref["table"][i];
+    json::ref jrefi = jref_table[i];
     jrefi["error_number"] = errnum;
     jrefi["log_index"] = erridx;
 
@@ -4563,7 +4564,8 @@ int ataPrintMain (ata_device * device, const ata_print_options & options)
     else if (nsectors_0x25 == 1)
       pout("OCP Telemetry not supported for GP Log 0x25 with 1 sector\n\n");
     else {
-      if (!print_ata_ocp_telemetry_log(device, nsectors_0x24, nsectors_0x25))
+      if (!print_ata_ocp_telemetry_log(device, nsectors_0x24, nsectors_0x25,
+                                       options.ocp_telemetry_opts))
         failuretest(OPTIONAL_CMD, returnval|=FAILSMART);
     }
   }
@@ -13,8 +13,11 @@
 #ifndef ATAPRINT_H_
 #define ATAPRINT_H_
 
+#include <string>
 #include <vector>
 
+#include "ocptelemetryprint.h"
+
 // Request to dump a GP or SMART log
 struct ata_log_request
 {
@@ -106,6 +109,7 @@ struct ata_print_options
   bool farm_log_suggest = false;  // If -x/-xall or -a/-all is run, suggests FARM log if supported
 
   bool ocp_telemetry = false;
+  ocp_telemetry_print_options ocp_telemetry_opts;
 };
 
 int ataPrintMain(smartmon::ata_device * device, const ata_print_options & options);
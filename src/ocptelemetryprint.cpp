@@ -104,17 +104,12 @@ static void hex_dump(char *buf, size_t len, unsigned int idx, bool ascii, bool s
   }
 }
 
-static void hex_dump_line(json::ref jref, void *data, size_t size, bool newline)
+static void hex_dump_line(json::ref jref, void *data, size_t size, bool newline, ocp_arena & arena)
 {
   // For single line, each byte will be printed as "0xXX "
   size_t string_size = size * 5 + 1;
-  char *val_hex = (char *)malloc(string_size);
+  char *val_hex = (char *)arena.alloc(string_size);
 
-  if (val_hex == NULL) {
-    jout("N/A");
-    jref = "N/A";
-    return;
-  }
   hex_dump(val_hex, string_size, 0, false, true, (uint8_t *)data, size);
   jout("%s", val_hex);
   if (newline)
@@ -177,7 +172,8 @@ static int64_t ocp_get_int_val(void *data, size_t size)
   }
 }
 
-static void ocp_print_stat_value(json::ref jref_data, enum ocp_data_type type, void *data, size_t size)
+static void ocp_print_stat_value(json::ref jref_data, enum ocp_data_type type, void *data, size_t size,
+                                 ocp_arena & arena)
 {
   switch (type) {
   case OCP_DATA_TYPE_INT: {
@@ -193,19 +189,17 @@ static void ocp_print_stat_value(json::ref jref_data, enum ocp_data_type type, v
     break;
   }
   case OCP_DATA_TYPE_ASCII: {
-          char *str = (char *)malloc(size + 1);
-    if (str == NULL)
-      break;
+    char *str = (char *)arena.alloc(size + 1);
     ocp_ascii_to_c_str(data, size, str, size + 1);
     jout("%s", str);
     jref_data = str;
     break;
   }
   case OCP_DATA_TYPE_FP:
-    hex_dump_line(jref_data, (uint8_t *)data, size, false);
+    hex_dump_line(jref_data, (uint8_t *)data, size, false, arena);
     break;
   case OCP_DATA_TYPE_NA:
-    hex_dump_line(jref_data, data, size, false);
+    hex_dump_line(jref_data, data, size, false, arena);
     break;
   }
 }
@@ -230,21 +224,17 @@ static int ocp_get_data_type(uint8_t info_2, enum ocp_data_type *type)
 
 static void ocp_stat_id_to_str(ocp_string_def *string_def, uint16_t id, char *stat_str, size_t size)
 {
-  for (size_t i = 0; i < OCP_BUILTIN_STAT_STR_LEN; i++) {
-    if (ocp_builtin_stat_str[i].id == id) {
-      strncpy(stat_str, ocp_builtin_stat_str[i].desc, size - 1);
-      return;
-    }
+  const char *desc = ocp_builtin_stat_id_to_str(id);
+  if (desc) {
+    snprintf(stat_str, size, "%s", desc);
+    return;
   }
 
   if (id >= 0x8000) {
-    std::map<uint16_t, struct ocp_statistic_id_string_table_entry>::iterator it =
-      string_def->stat_id_string_map.find(id);
-    if (it != string_def->stat_id_string_map.end()) {
-      uint64_t offset = sg_get_unaligned_le64(it->second.ascii_id_offset);
-      memcpy(stat_str, &string_def->ocp_string_ascii_table[offset], it->second.ascii_id_len);
-      stat_str[it->second.ascii_id_len] = 0;
-    } else
+    ocp_string_ref ref;
+    if (ocp_find_stat_id_string(string_def, id, &ref))
+      snprintf(stat_str, size, "%.*s", (int)ref.len, ref.str);
+    else
       snprintf(stat_str, size, "Vendor Unique ID");
   } else {
     snprintf(stat_str, size, "Reserved ID");
@@ -322,7 +312,7 @@ static void print_hdd_spinup_stat_desc(json::ref jref, struct ocp_hdd_spinup_sta
 }
 
 static void print_custom_stat_desc(json::ref jref, struct ocp_statistic_descriptor *sp, enum ocp_data_type data_type,
-                                   unsigned indent)
+                                   unsigned indent, ocp_arena & arena)
 {
   switch (sp->h.statistics_id) {
   case 0x02:
@@ -338,7 +328,7 @@ static void print_custom_stat_desc(json::ref jref, struct ocp_statistic_descript
     print_hdd_spinup_stat_desc(jref, (struct ocp_hdd_spinup_stat_desc *)sp, indent);
     break;
   default:
-    ocp_print_stat_value(jref["data"], data_type, sp->custom.data, sp->h.statistic_data_size << 2);
+    ocp_print_stat_value(jref["data"], data_type, sp->custom.data, sp->h.statistic_data_size << 2, arena);
   }
 }
 
@@ -459,9 +449,10 @@ static void ocp_print_stat_desc_info(json::ref jref, struct ocp_statistic_descri
   jref["data type"] = val;
 }
 
-static bool ocp_print_stat_desc(json::ref jref, struct ocp_statistic_descriptor *sp, unsigned indent,
-                                ocp_string_def *string_def)
+static bool ocp_print_stat_desc(json::ref jref, const ocp_stat_desc_view & desc, unsigned indent,
+                                ocp_telemetry_session & session)
 {
+  struct ocp_statistic_descriptor *sp = (struct ocp_statistic_descriptor *)desc.raw();
   enum ocp_stat_type stat_type;
   enum ocp_data_type data_type;
   char stat_id_str[OCP_STR_BUF_SIZE];
@@ -479,7 +470,14 @@ static bool ocp_print_stat_desc(json::ref jref, struct ocp_statistic_descriptor
     return false;
   }
 
-  ocp_stat_id_to_str(string_def, sp->h.statistics_id, stat_id_str, sizeof stat_id_str);
+  if (   stat_type == OCP_STAT_TYPE_ARRAY
+      && !(   desc.data_size() >= 4
+           && desc.num_elements() == sg_get_unaligned_le16(&sp->array.number_of_elements) + 1U)) {
+    jout("Malformed statistic descriptor skipped - array exceeds statistic data\n");
+    return false;
+  }
+
+  ocp_stat_id_to_str(&session.string_def, sp->h.statistics_id, stat_id_str, sizeof stat_id_str);
   jout("%sStatistic ID             : 0x%04" PRIx16 ", %s\n", header, sp->h.statistics_id, stat_id_str);
   jref["ID"] = stat_id_str;
 
@@ -492,22 +490,23 @@ static bool ocp_print_stat_desc(json::ref jref, struct ocp_statistic_descriptor
 
   switch (stat_type) {
   case OCP_STAT_TYPE_SINGLE:
-    ocp_print_stat_value(jref["data"], data_type, sp->single.data, sp->h.statistic_data_size << 2);
+    ocp_print_stat_value(jref["data"], data_type, sp->single.data, sp->h.statistic_data_size << 2,
+                         session.arena());
     break;
   case OCP_STAT_TYPE_ARRAY: {
-    uint8_t *data = sp->array.data;
+    unsigned num_elements = desc.num_elements();
     jout("[ ");
-    for (int elem = 0; elem < (sp->array.number_of_elements + 1); ++elem) {
+    for (unsigned elem = 0; elem < num_elements; ++elem) {
       if (elem > 0)
         jout(", ");
-      ocp_print_stat_value(jref["data"][elem], data_type, data, sp->array.element_size + 1);
-      data += sp->array.element_size + 1;
+      ocp_print_stat_value(jref["data"][elem], data_type, (uint8_t *)desc.element(elem),
+                           desc.element_size(), session.arena());
     }
     jout(" ]");
     break;
   }
   case OCP_STAT_TYPE_CUSTOM:
-    print_custom_stat_desc(jref, sp, data_type, indent + 2);
+    print_custom_stat_desc(jref, sp, data_type, indent + 2, session.arena());
     break;
   }
 
@@ -516,32 +515,24 @@ static bool ocp_print_stat_desc(json::ref jref, struct ocp_statistic_descriptor
   return true;
 }
 
-static void ocp_print_telemetry_statistics(json::ref stat_list, void *log_page, size_t dwords,
-                                           ocp_string_def *string_def)
+static void ocp_print_telemetry_statistics(json::ref stat_list, const void *log_page, size_t dwords,
+                                           ocp_telemetry_session & session)
 {
-  uint32_t *log_page_dwords = (uint32_t *)log_page;
+  ocp_stat_desc_range descs(log_page, dwords);
   unsigned idx = 0;
   char buffer[OCP_STR_BUF_SIZE];
 
-  while (dwords) {
-    struct ocp_statistic_descriptor *sp;
-    size_t dwords_consumed;
-
-    sp = (struct ocp_statistic_descriptor *)log_page_dwords;
-    if (sp->h.statistics_id == 0)
-      break;
-    dwords_consumed = (sizeof(sp->h) >> 2) + sp->h.statistic_data_size;
-
+  ocp_stat_desc_range::iterator it;
+  for (it = descs.begin(); it != descs.end(); ++it) {
     snprintf(buffer, sizeof buffer, "Statistic Descriptor %i", idx);
     jout("  %s\n", buffer);
     json::ref jref_desc = stat_list[idx];
 
-    if (ocp_print_stat_desc(jref_desc, sp, 4, string_def))
+    if (ocp_print_stat_desc(jref_desc, *it, 4, session))
       idx++;
-
-    dwords -= dwords_consumed;
-    log_page_dwords += dwords_consumed;
   }
+  if (it.truncated())
+    jout("Malformed statistic descriptor skipped - exceeds statistic area\n");
   jout("\n");
 }
 
@@ -764,13 +755,9 @@ static bool event_id_to_str(uint8_t dbg_class, uint8_t id[2], char *event_str, s
   if (success)
     return true;
 
-  std::map<uint32_t, struct ocp_event_id_string_table_entry>::iterator it =
-    string_def->event_string_map.find(OCP_EVENT_KEY(dbg_class, id));
-  if (it != string_def->event_string_map.end()) {
-    uint64_t offset = sg_get_unaligned_le64(it->second.ascii_id_offset);
-    size_t to_copy = MIN(size -1, it->second.ascii_id_len);
-    memcpy(event_str, &string_def->ocp_string_ascii_table[offset], to_copy);
-    event_str[to_copy] = 0;
+  ocp_string_ref ref;
+  if (ocp_find_event_string(string_def, dbg_class, id, &ref)) {
+    snprintf(event_str, size, "%.*s", (int)ref.len, ref.str);
   } else  if (event_id >= 0x8000) {
     strncpy(event_str, "Vendor Unique ID", size - 1);
   } else {
@@ -779,8 +766,8 @@ static bool event_id_to_str(uint8_t dbg_class, uint8_t id[2], char *event_str, s
   return true;
 }
 
-static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], uint8_t *data, uint8_t size,
-                             unsigned indent, ocp_string_def *string_def)
+static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], uint8_t *data, int size,
+                             unsigned indent, ocp_telemetry_session & session)
 {
   char buffer[OCP_STR_BUF_SIZE];
   char header[OCP_STR_BUF_SIZE];
@@ -790,7 +777,7 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
   event_class_to_str(dbg_class, buffer, sizeof buffer);
   jout("%sClass                    : 0x%02" PRIx8 ", %s\n", header, dbg_class, buffer);
   jref["Class"] = buffer;
-  if (event_id_to_str(dbg_class, id, buffer, sizeof buffer, string_def)) {
+  if (event_id_to_str(dbg_class, id, buffer, sizeof buffer, &session.string_def)) {
     jout("%sId                       : 0x%04" PRIx16 ", %s\n", header, sg_get_unaligned_le16(id), buffer);
     jref["ID"] = buffer;
   }
@@ -823,9 +810,13 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
     size -= sizeof(struct ocp_event_media_wear);
     break;
   case OCP_EVENT_CLASS_STATISTIC_SNAP: {
-    struct ocp_statistic_descriptor *sp = (struct ocp_statistic_descriptor *)data;
     jout("%sStatistic Descriptor Snapshot:\n", header);
-    ocp_print_stat_desc(jref["Statistic descriptor"], sp, indent + 2, string_def);
+    size_t desc_size = (size > 0 ? ocp_stat_desc_view::desc_size(data, size) : 0);
+    if (!desc_size || desc_size > (size_t)size)
+      jout("Malformed statistic descriptor skipped - exceeds event data\n");
+    else
+      ocp_print_stat_desc(jref["Statistic descriptor"], ocp_stat_desc_view(data, desc_size),
+                          indent + 2, session);
     size = 0;
     break;
   }
@@ -836,7 +827,7 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
     uint8_t data_area = marker >> 11 & 0x7;
     jout("%sVirtual FIFO Data Area   : 0x%04" PRIx8 "\n", header, data_area);
     jref["data area"] = data_area;
-    if (event_id_to_str(dbg_class, vf->marker, buffer, sizeof buffer, string_def)) {
+    if (event_id_to_str(dbg_class, vf->marker, buffer, sizeof buffer, &session.string_def)) {
       jout("%sVirtual FIFO Number      : 0x%04" PRIx16 "\n", header, number);
       jout("%sVirtual FIFO Name        : %s\n", header, buffer);
       jref["virtual fifo number"] = number;
@@ -849,7 +840,7 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
   case OCP_EVENT_CLASS_SATA_TRANSPORT: {
     struct ocp_event_class_0Dh *class_0Dh = (struct ocp_event_class_0Dh *)data;
     jout("%sFIS                      : ", header);
-    hex_dump_line(jref["FIS"], class_0Dh->fis, sizeof class_0Dh->fis, true);
+    hex_dump_line(jref["FIS"], class_0Dh->fis, sizeof class_0Dh->fis, true, session.arena());
     data += sizeof class_0Dh->fis;
     size -= sizeof class_0Dh->fis;
     break;
@@ -859,7 +850,7 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
   if (size > 0 && dbg_class < 0x80) {
     struct ocp_event_vu *vu = (struct ocp_event_vu *)data;
 
-    event_id_to_str(dbg_class, vu->id, buffer, sizeof buffer, string_def);
+    event_id_to_str(dbg_class, vu->id, buffer, sizeof buffer, &session.string_def);
     jout("%sVU Event ID              : 0x%04" PRIx16 ", %s\n", header, sg_get_unaligned_le16(vu->id), buffer);
     jref["VU ID"] = sg_get_unaligned_le16(vu->id);
     data += sizeof *vu;
@@ -867,53 +858,101 @@ static void print_event_desc(json::ref jref, uint8_t dbg_class, uint8_t id[2], u
   }
   if (size > 0) {
     jout("%sVU Data                  : ", header);
-    hex_dump_line(jref["vu data"], data, size, true);
+    hex_dump_line(jref["vu data"], data, size, true, session.arena());
   }
 }
 
-static size_t ocp_get_event_desc_dwords(struct ocp_event_descriptor *e, size_t max_size)
-{
-  if (e->debug_event_class_type == OCP_EVENT_CLASS_STATISTIC_SNAP) {
-    struct ocp_statistic_header *s;
-    /* Need the statistics descriptor header in the snapshot to
-     * determine the complete length. */
-    if (max_size < sizeof *e + sizeof *s) {
-      return sizeof *e + sizeof *s;
-    }
-    s = (struct ocp_statistic_header *)e->data;
-    return (sizeof *e >> 2) + (sizeof *s >> 2) + s->statistic_data_size;
-  } else
-    return (sizeof *e >> 2) + e->data_size;
-}
-
-static void ocp_print_telemetry_events(json::ref event_list, void *log_page, size_t dwords,
-                                       ocp_string_def *string_def)
+static void ocp_print_telemetry_events(json::ref event_list, const void *log_page, size_t dwords,
+                                       ocp_telemetry_session & session)
 {
-  uint32_t *log_page_dwords = (uint32_t *)log_page;
+  ocp_event_desc_range descs(log_page, dwords);
   char buffer[OCP_STR_BUF_SIZE];
   unsigned idx = 0;
 
-  while (dwords) {
-    struct ocp_event_descriptor *ep;
-    size_t dwords_consumed;
-
-    ep = (struct ocp_event_descriptor *)log_page_dwords;
-    if (ep->debug_event_class_type == 0)
-      // End of FIFO
-      break;
-    dwords_consumed = ocp_get_event_desc_dwords(ep, dwords << 2);
+  ocp_event_desc_range::iterator it;
+  for (it = descs.begin(); it != descs.end(); ++it) {
+    struct ocp_event_descriptor *ep = (struct ocp_event_descriptor *)it->raw();
 
     snprintf(buffer, sizeof(buffer), "Event Descriptor %i", idx);
     jout("  %s\n", buffer);
     json::ref jref_desc = event_list[idx];
 
     print_event_desc(jref_desc, ep->debug_event_class_type, ep->event_id, ep->data,
-                     ep->data_size << 2, 4, string_def);
+                     ep->data_size << 2, 4, session);
 
     idx++;
-    dwords -= dwords_consumed;
-    log_page_dwords += dwords_consumed;
   }
+  if (it.truncated())
+    jout("Malformed event descriptor skipped - exceeds event FIFO\n");
+  jout("\n");
+}
+
+// Print events of both FIFOs in time order.
+static void ocp_print_event_timeline(json::ref jref, const ocp_event_timeline & timeline,
+                                     ocp_telemetry_session & session)
+{
+  jout("OCP Event Timeline\n");
+  json::ref event_list = jref["event_timeline"].stream();
+  unsigned idx = 0;
+
+  for (const ocp_timeline_event & e : timeline.events()) {
+    struct ocp_event_descriptor *ep = (struct ocp_event_descriptor *)e.desc.raw();
+    json::ref jref_desc = event_list[idx];
+
+    jout("  Event %u: FIFO %u, Event Descriptor %u, ", idx, e.fifo, e.index);
+    if (e.time_valid) {
+      jout("Time 0x%04" PRIx64 "\n", e.time);
+      jref_desc["time"] = e.time;
+    }
+    else
+      jout("Time unknown\n");
+    jref_desc["fifo"] = e.fifo;
+    jref_desc["index"] = e.index;
+
+    print_event_desc(jref_desc, ep->debug_event_class_type, ep->event_id, ep->data,
+                     ep->data_size << 2, 4, session);
+    idx++;
+  }
+  jout("\n");
+}
+
+// Print time series of the statistics in statistic snapshot events.
+static void ocp_print_stat_time_series(json::ref jref, const ocp_event_timeline & timeline,
+                                       ocp_telemetry_session & session)
+{
+  ocp_stat_time_series stats;
+  stats.add(timeline);
+
+  jout("OCP Statistic Snapshot Time Series\n");
+  json::ref series_list = jref["statistic_time_series"];
+  unsigned idx = 0;
+
+  for (const ocp_stat_time_series::series & ss : stats.all()) {
+    char stat_id_str[OCP_STR_BUF_SIZE];
+    ocp_stat_id_to_str(&session.string_def, ss.id, stat_id_str, sizeof stat_id_str);
+    jout("  Statistic ID 0x%04" PRIx16 ", %s: %u samples\n", ss.id, stat_id_str,
+         (unsigned)ss.size());
+    json::ref jref1 = series_list[idx++];
+    jref1["id"] = ss.id;
+    jref1["name"] = stat_id_str;
+
+    // Columns of times and values
+    json::ref jref_time = jref1["time"], jref_value = jref1["value"];
+    jout("    Time             Value\n");
+    for (size_t i = 0; i < ss.size(); i++) {
+      jref_time[i] = ss.times[i];
+      if (ss.data_type == OCP_DATA_TYPE_INT) {
+        jout("    0x%-14" PRIx64 " %" PRId64 "\n", ss.times[i], ss.int_value(i));
+        jref_value[i] = ss.int_value(i);
+      }
+      else {
+        jout("    0x%-14" PRIx64 " %" PRIu64 "\n", ss.times[i], ss.values[i]);
+        jref_value[i] = ss.values[i];
+      }
+    }
+  }
+  if (!idx)
+    jout("  No statistic snapshot events with time found\n");
   jout("\n");
 }
 
@@ -955,11 +994,16 @@ static void ocp_print_telemetry_data_header(json::ref stat_log, struct ocp_telem
   jout("\n");
 }
 
-void print_ata_device_internal_status(json::ref jref, struct ata_device_internal_status *log, bool current)
+static void print_ata_device_internal_status(json::ref jref, struct ata_device_internal_status *log,
+                                             bool current, bool scsi, ocp_arena & arena)
 {
-  json::ref jref_ata = current ? jref["ata current device internal status"] :
-                                       jref["ata saved device internal status"];
-  if (current)
+  json::ref jref_ata = (scsi ? (current ? jref["scsi current internal status"] :
+                                          jref["scsi saved internal status"]) :
+                               (current ? jref["ata current device internal status"] :
+                                          jref["ata saved device internal status"]));
+  if (scsi)
+    jout("%s Internal Status Parameter Data (Error History)\n", current ? "Current" : "Saved");
+  else if (current)
     jout("Current Device Internal Status log (GP Log 0x24)\n");
   else
     jout("Saved Device Internal Status log (GP Log 0x25)\n");
@@ -984,11 +1028,11 @@ void print_ata_device_internal_status(json::ref jref, struct ata_device_internal
   jref1["valid flags"] = rid->valid_flags & 0xf;
   if (rid->valid_flags & OCP_REASON_ID_ERROR_ID) {
     jout("    Error ID            : ");
-    hex_dump_line(jref1["error id"], rid->error_id, sizeof rid->error_id, true);
+    hex_dump_line(jref1["error id"], rid->error_id, sizeof rid->error_id, true, arena);
   }
   if (rid->valid_flags & OCP_REASON_ID_FILE_ID) {
     jout("    File ID             : ");
-    hex_dump_line(jref1["file id"], rid->file_id, sizeof rid->file_id, true);
+    hex_dump_line(jref1["file id"], rid->file_id, sizeof rid->file_id, true, arena);
   }
   if (rid->valid_flags & OCP_REASON_ID_LINE_NUMBER) {
     jout("    Line number         : 0x%04" PRIx16 "\n", rid->line_number);
@@ -997,14 +1041,14 @@ void print_ata_device_internal_status(json::ref jref, struct ata_device_internal
   if (rid->valid_flags & OCP_REASON_ID_VU_EXT) {
     jout("    VU Reason Extension : ");
     hex_dump_line(jref1["vu reason extension"], rid->vu_reason_extension,
-                  sizeof rid->vu_reason_extension, true);
+                  sizeof rid->vu_reason_extension, true, arena);
   }
   jout("\n");
 }
 
 static void ocp_print_telemetry_strings_header(json::ref stat_log,
                                                struct ocp_telemetry_strings_header *header,
-                                               ocp_string_def *string_def)
+                                               const ocp_string_def *string_def)
 {
   jout("OCP Telemetry Strings Header\n");
   json::ref jref = stat_log["ocp_telemetry_strings_header"];
@@ -1027,12 +1071,8 @@ static void ocp_print_telemetry_strings_header(json::ref stat_log,
   jout("    Start                  : 0x%04" PRIx64 "\n", header->ascii_table_start);
   jout("    Size                   : 0x%04" PRIx64 "\n", header->ascii_table_size);
 
-  ocp_ascii_to_c_str(header->event_fifo_1_name, sizeof header->event_fifo_1_name,
-                     string_def->event_fifo_1_name, sizeof string_def->event_fifo_1_name);
   jout("  Event FIFO 1 Name        : %s\n", string_def->event_fifo_1_name);
   jref["event fifo 1 name"] = string_def->event_fifo_1_name;
-  ocp_ascii_to_c_str(header->event_fifo_2_name, sizeof header->event_fifo_2_name,
-                     string_def->event_fifo_2_name, sizeof string_def->event_fifo_2_name);
   jout("  Event FIFO 2 Name        : %s\n", string_def->event_fifo_2_name);
   jref["event fifo 2 name"] = string_def->event_fifo_2_name;
   jout("\n");
@@ -1041,79 +1081,241 @@ static void ocp_print_telemetry_strings_header(json::ref stat_log,
 ///////////////////////////////////////////////////////////////////////
 // Print OCP Telemetry Log Pages
 
-bool print_ata_ocp_telemetry_log(ata_device * device, unsigned nsectors_0x24, unsigned nsectors_0x25)
+// Read the string tables.  If CACHE_DIR is specified, the tables are read
+// from or written to the cache selected by the already read data header.
+static bool read_ocp_telemetry_strings(ocp_log_reader & reader, unsigned nsectors_0x25,
+                                       ocp_telemetry_session & session, const char * cache_dir)
 {
-  struct ata_device_internal_status internal_status;
-  struct ocp_telemetry_strings_header ocp_strings_header;
-  ocp_string_def ocp_strings;
+  if (!cache_dir)
+    return session.read_strings(reader, nsectors_0x25);
 
-  if (!read_ata_ocp_telemetry_string_state(device, nsectors_0x25, &internal_status,
-                                           &ocp_strings_header, &ocp_strings)) {
+  ocp_string_cache cache(cache_dir, session.data_header.firmware_version);
+  if (!session.read_strings(reader, nsectors_0x25, &cache))
+    return false;
+
+  std::string errmsg;
+  if (!cache.is_loaded() && !cache.save(&session.string_def, errmsg))
+    pout("Write OCP Telemetry string cache failed: %s\n\n", errmsg.c_str());
+  return true;
+}
+
+// Print only the events added since the last call with the same cursor file.
+static bool print_ocp_telemetry_new_events(ocp_log_reader & reader, unsigned nsectors_0x24,
+                                           unsigned nsectors_0x25,
+                                           const ocp_telemetry_print_options & options)
+{
+  const char * cursor_file = options.cursor_file.c_str();
+  ocp_event_cursor cursors[2];
+  std::string errmsg;
+  if (!ocp_load_event_cursors(cursor_file, cursors, errmsg)) {
+    jerr("Read OCP Telemetry event cursors failed: %s\n\n", errmsg.c_str());
     return false;
   }
 
-  json::ref jref_strings = jglb["ocp_telemetry_strings"];
-  print_ata_device_internal_status(jref_strings, &internal_status, false);
-  ocp_print_telemetry_strings_header(jref_strings, &ocp_strings_header, &ocp_strings);
+  ocp_telemetry_session session;
+  if (!session.read_data_header(reader, nsectors_0x24))
+    return false;
+  if (!read_ocp_telemetry_strings(reader, nsectors_0x25, session,
+                                  (!options.cache_dir.empty() ? options.cache_dir.c_str() : nullptr)))
+    return false;
 
-  struct ocp_telemetry_data_header ocp_data_header;
-  char *logs = NULL;
+  json::ref jref = jglb["ocp_telemetry_data"];
+  ocp_print_telemetry_data_header(jref, &session.data_header);
+
+  std::vector<uint8_t> events[2];
+  ocp_event_timeline timeline;
+  for (int i = 0; i < 2; i++) {
+    // Time of the last event read before, if any
+    uint64_t start_time = cursors[i].last_timestamp;
+    bool lost = false;
+    if (!read_ata_ocp_telemetry_new_events(reader, &session.data_header, i + 1, &cursors[i],
+                                           events[i], &lost)) {
+      return false;
+    }
+    if (!(i == 0 ? session.data_header.event1_FIFO_size_dword
+                 : session.data_header.event2_FIFO_size_dword))
+      continue;
+
+    json::ref jref1 = jref[i == 0 ? "event_fifo_1" : "event_fifo_2"];
+    const char * name = (i == 0 ? session.string_def.event_fifo_1_name
+                                : session.string_def.event_fifo_2_name);
+    jout("OCP Event Fifo %d", i + 1);
+    if (strlen(name) > 0) {
+      jout(": %s", name);
+      jref1["name"] = name;
+    }
+    jout(" (new events only)\n");
+    jref1["new_events_only"] = true;
+    jref1["events_lost"] = lost;
+    if (lost)
+      jout("Last read event not found, events may have been lost\n");
+    timeline.add_fifo(i + 1, events[i].data(), events[i].size() >> 2,
+                      (start_time && !lost ? &start_time : nullptr));
+    if (options.timeline) {
+      jout("\n");
+      continue;
+    }
+    json::ref jref2 = jref1["events"].stream();
+    ocp_print_telemetry_events(jref2, events[i].data(), events[i].size() >> 2, session);
+  }
+  if (options.timeline)
+    ocp_print_event_timeline(jref, timeline, session);
+  if (options.stat_series)
+    ocp_print_stat_time_series(jref, timeline, session);
 
-  if (!read_ata_ocp_telemetry_statistics(device, nsectors_0x24, &internal_status,
-                                         &ocp_data_header, &logs)) {
+  if (!ocp_save_event_cursors(cursor_file, cursors, errmsg)) {
+    jerr("Write OCP Telemetry event cursors failed: %s\n\n", errmsg.c_str());
     return false;
   }
+  return true;
+}
+
+static bool print_ocp_telemetry_log(ocp_log_reader & reader, unsigned nsectors_0x24,
+                                    unsigned nsectors_0x25, bool scsi,
+                                    const ocp_telemetry_print_options & options)
+{
+  if (!options.cursor_file.empty())
+    return print_ocp_telemetry_new_events(reader, nsectors_0x24, nsectors_0x25, options);
+
+  const char * cache_dir = (!options.cache_dir.empty() ? options.cache_dir.c_str() : nullptr);
+  ocp_telemetry_session session;
+  // The string table cache is selected by the firmware version
+  if (cache_dir && !session.read_data_header(reader, nsectors_0x24))
+    return false;
+  if (!read_ocp_telemetry_strings(reader, nsectors_0x25, session, cache_dir))
+    return false;
+
+  json::ref jref_strings = jglb["ocp_telemetry_strings"];
+  print_ata_device_internal_status(jref_strings, &session.strings_status, false, scsi,
+                                   session.arena());
+  ocp_print_telemetry_strings_header(jref_strings, &session.strings_header, &session.string_def);
+
+  if (!session.read_data(reader, nsectors_0x24))
+    return false;
 
   json::ref jref = jglb["ocp_telemetry_data"];
-  print_ata_device_internal_status(jref, &internal_status, true);
-  ocp_print_telemetry_data_header(jref, &ocp_data_header);
-
-  size_t bytes_printed = 0;
-  if (ocp_data_header.statistic1_size_dword > 0) {
-    json::ref jref1 = jref["statistic_area_1"];
-    jout("OCP Statistics Area 1\n");
-    ocp_print_telemetry_statistics(jref1, logs,
-                                   ocp_data_header.statistic1_size_dword,
-                                   &ocp_strings);
-    bytes_printed = ocp_data_header.statistic1_size_dword << 2;
-  }
-  if (ocp_data_header.statistic2_size_dword > 0) {
-    json::ref jref1 = jref["statistic_area_2"];
-    jout("OCP Statistics Area 2\n");
-    ocp_print_telemetry_statistics(jref1, &logs[bytes_printed],
-                                   ocp_data_header.statistic2_size_dword,
-                                   &ocp_strings);
-    bytes_printed += ocp_data_header.statistic2_size_dword << 2;
-  }
-  if (ocp_data_header.event1_FIFO_size_dword > 0) {
-    json::ref jref1 = jref["event_fifo_1"];
-    jout("OCP Event Fifo 1");
-    if (strlen(ocp_strings.event_fifo_1_name) > 0) {
-      jout(": %s", ocp_strings.event_fifo_1_name);
-      jref1["name"] = ocp_strings.event_fifo_1_name;
+  print_ata_device_internal_status(jref, &session.data_status, true, scsi, session.arena());
+  ocp_print_telemetry_data_header(jref, &session.data_header);
+
+  for (int i = 0; i < 2; i++) {
+    const ocp_telemetry_session::area & area = session.statistic_areas[i];
+    if (!area.data)
+      continue;
+    json::ref jref1 = jref[i == 0 ? "statistic_area_1" : "statistic_area_2"].stream();
+    jout("OCP Statistics Area %d\n", i + 1);
+    ocp_print_telemetry_statistics(jref1, area.data, area.dwords, session);
+  }
+
+  ocp_event_timeline timeline;
+  for (int i = 0; i < 2; i++) {
+    const ocp_telemetry_session::area & area = session.event_fifos[i];
+    if (!area.data)
+      continue;
+    if (options.timeline || options.stat_series) {
+      if (!timeline.add_fifo(i + 1, area.data, area.dwords) && options.timeline)
+        jout("Malformed event descriptor of Event FIFO %d skipped - exceeds event FIFO\n", i + 1);
     }
-    jout("\n");
-    json::ref jref2 = jref1["events"];
-    ocp_print_telemetry_events(jref2, &logs[bytes_printed],
-                               ocp_data_header.event1_FIFO_size_dword,
-                               &ocp_strings);
-    bytes_printed += ocp_data_header.event1_FIFO_size_dword << 2;
-  }
-  if (ocp_data_header.event2_FIFO_size_dword > 0) {
-    json::ref jref1 = jref["event_fifo_2"];
-    jout("OCP Event Fifo 2");
-    if (strlen(ocp_strings.event_fifo_2_name) > 0) {
-      jout(": %s", ocp_strings.event_fifo_2_name);
-      jref1["name"] = ocp_strings.event_fifo_2_name;
+    if (options.timeline)
+      continue;
+    json::ref jref1 = jref[i == 0 ? "event_fifo_1" : "event_fifo_2"];
+    const char * name = (i == 0 ? session.string_def.event_fifo_1_name
+                                : session.string_def.event_fifo_2_name);
+    jout("OCP Event Fifo %d", i + 1);
+    if (strlen(name) > 0) {
+      jout(": %s", name);
+      jref1["name"] = name;
     }
     jout("\n");
-    json::ref jref2 = jref1["events"];
-    ocp_print_telemetry_events(jref2, &logs[bytes_printed],
-                               ocp_data_header.event2_FIFO_size_dword,
-                               &ocp_strings);
+    json::ref jref2 = jref1["events"].stream();
+    ocp_print_telemetry_events(jref2, area.data, area.dwords, session);
   }
-
-  free(logs);
+  if (options.timeline)
+    ocp_print_event_timeline(jref, timeline, session);
+  if (options.stat_series)
+    ocp_print_stat_time_series(jref, timeline, session);
 
   return true;
 }
+
+static bool print_ocp_telemetry_log_with_capture(ocp_capture_log_reader & capture,
+                                                 unsigned nsectors_0x24, unsigned nsectors_0x25,
+                                                 const ocp_telemetry_print_options & options)
+{
+  // Bypass the cache, the capture must contain the string tables
+  ocp_telemetry_print_options save_options = options;
+  save_options.cache_dir.clear();
+  bool ok = print_ocp_telemetry_log(capture, nsectors_0x24, nsectors_0x25, capture.is_scsi(),
+                                    save_options);
+
+  // Save also a partial capture to allow analysis of read errors
+  const char * capture_file = options.capture_file.c_str();
+  std::string errmsg;
+  if (!capture.save(capture_file, errmsg)) {
+    jerr("Write OCP Telemetry capture failed: %s\n\n", errmsg.c_str());
+    return false;
+  }
+  pout("OCP Telemetry capture written to %s\n\n", capture_file);
+  return ok;
+}
+
+bool print_ata_ocp_telemetry_log(ata_device * device, unsigned nsectors_0x24, unsigned nsectors_0x25,
+                                 const ocp_telemetry_print_options & options)
+{
+  ocp_ata_log_reader reader(device);
+  if (options.capture_file.empty())
+    return print_ocp_telemetry_log(reader, nsectors_0x24, nsectors_0x25, false, options);
+
+  ocp_capture_log_reader capture(&reader);
+  capture.set_num_sectors(0x24, nsectors_0x24);
+  capture.set_num_sectors(0x25, nsectors_0x25);
+  return print_ocp_telemetry_log_with_capture(capture, nsectors_0x24, nsectors_0x25, options);
+}
+
+bool print_scsi_ocp_telemetry_log(scsi_device * device, const ocp_telemetry_print_options & options)
+{
+  ocp_scsi_log_reader reader(device);
+  if (!reader.read_directory()) {
+    pout("OCP Telemetry not supported: %s\n\n", device->get_errmsg());
+    return false;
+  }
+
+  unsigned nsectors_0x24 = reader.get_num_sectors(0x24);
+  unsigned nsectors_0x25 = reader.get_num_sectors(0x25);
+  if (nsectors_0x24 < 2 || nsectors_0x25 < 2) {
+    pout("OCP Telemetry not supported for internal status buffers with less than 2 pages\n\n");
+    return false;
+  }
+
+  if (options.capture_file.empty())
+    return print_ocp_telemetry_log(reader, nsectors_0x24, nsectors_0x25, true, options);
+
+  ocp_capture_log_reader capture(&reader);
+  capture.set_scsi(true);
+  capture.set_num_sectors(0x24, nsectors_0x24);
+  capture.set_num_sectors(0x25, nsectors_0x25);
+  return print_ocp_telemetry_log_with_capture(capture, nsectors_0x24, nsectors_0x25, options);
+}
+
+bool print_ocp_telemetry_capture(const char * capture_file,
+                                 const ocp_telemetry_print_options & options)
+{
+  ocp_capture_log_reader capture;
+  std::string errmsg;
+  if (!capture.load(capture_file, errmsg)) {
+    jerr("Read OCP Telemetry capture failed: %s\n\n", errmsg.c_str());
+    return false;
+  }
+
+  unsigned nsectors_0x24 = capture.get_num_sectors(0x24);
+  unsigned nsectors_0x25 = capture.get_num_sectors(0x25);
+  if (nsectors_0x24 < 2 || nsectors_0x25 < 2) {
+    jerr("Read OCP Telemetry capture failed: %s: GP Log 0x24 or 0x25 missing\n\n", capture_file);
+    return false;
+  }
+
+  // The capture contains the string tables, the cache is not used
+  ocp_telemetry_print_options load_options = options;
+  load_options.cache_dir.clear();
+  return print_ocp_telemetry_log(capture, nsectors_0x24, nsectors_0x25, capture.is_scsi(),
+                                 load_options);
+}
@@ -9,8 +9,30 @@
 #ifndef OCPTELEMETRYPRINT_H
 #define OCPTELEMETRYPRINT_H
 
+#include <string>
+
 #include <smartmon/dev_interface.h>
 
-bool print_ata_ocp_telemetry_log(smartmon::ata_device * device, unsigned nsectors_0x24, unsigned nsectors_0x25);
+// Options for OCP telemetry output.
+struct ocp_telemetry_print_options
+{
+  std::string capture_file; // Write the raw log pages to this file
+  std::string cache_dir; // Directory of string table cache
+  std::string cursor_file; // Print only new events, cursors are kept in this file
+  bool timeline = false; // Print events of both FIFOs merged in time order
+  bool stat_series = false; // Print time series of statistic snapshot events
+};
+
+// Print OCP telemetry of DEVICE.
+bool print_ata_ocp_telemetry_log(smartmon::ata_device * device, unsigned nsectors_0x24, unsigned nsectors_0x25,
+                                 const ocp_telemetry_print_options & options);
+
+// Print OCP telemetry of a SAS DEVICE.
+bool print_scsi_ocp_telemetry_log(smartmon::scsi_device * device,
+                                  const ocp_telemetry_print_options & options);
+
+// Print OCP telemetry from a file written with the capture_file option.
+bool print_ocp_telemetry_capture(const char * capture_file,
+                                 const ocp_telemetry_print_options & options);
 
 #endif // OCPTELEMETRYPRINT_H
@@ -30,6 +30,7 @@
 
 #include <smartmon/farmcmds.h>
 #include "farmprint.h"
+#include "ocptelemetryprint.h"
 
 using namespace smartmon;
 
@@ -103,6 +104,24 @@ static const char * ssm_s = "Solid state media";
 static const char * zbds_s = "Zoned block device statistics";
 static const char * lp_s = "log page";
 
+/* Forget state of previous device (smartctl --json=n DEVICE...) */
+static void
+scsiResetDeviceState()
+{
+    gSmartLPage = gTempLPage = gSelfTestLPage = gStartStopLPage = false;
+    gReadECounterLPage = gWriteECounterLPage = gVerifyECounterLPage = false;
+    gNonMediumELPage = gLastNErrorEvLPage = gBackgroundResultsLPage = false;
+    gProtocolSpecificLPage = gTapeAlertsLPage = gSSMediaLPage = false;
+    gFormatStatusLPage = gEnviroReportingLPage = gEnviroLimitsLPage = false;
+    gUtilizationLPage = gPendDefectsLPage = gBackgroundOpLPage = false;
+    gLPSMisalignLPage = gTapeDeviceStatsLPage = gZBDeviceStatsLPage = false;
+    gGenStatsAndPerfLPage = false;
+    gSeagateCacheLPage = gSeagateFactoryLPage = gSeagateFarmLPage = false;
+    gIecMPage = true;
+    modese_len = 0;
+    scsi_version = 0;
+    scsi_vendor[0] = 0;
+}
 
 static bool
 seagate_or_hitachi(void)
@@ -3511,6 +3530,8 @@ scsiPrintMain(scsi_device * device, const scsi_print_options & options)
     bool is_tape;
     bool any_output = options.drive_info;
 
+    scsiResetDeviceState();
+
 // Enable -n option for SCSI Drives
     const char * powername = nullptr;
     bool powerchg = false;
@@ -3812,6 +3833,12 @@ scsiPrintMain(scsi_device * device, const scsi_print_options & options)
         jglb["seagate_farm_log"]["supported"] = farm_supported;
         any_output = true;
     }
+    // Print OCP Telemetry
+    if (options.ocp_telemetry) {
+        if (!print_scsi_ocp_telemetry_log(device, options.ocp_telemetry_opts))
+            failuretest(OPTIONAL_CMD, returnval |= FAILSMART);
+        any_output = true;
+    }
     if (options.smart_error_log || options.scsi_pending_defects) {
         if (options.smart_error_log) {
             scsiPrintErrorCounterLog(device);
@@ -16,6 +16,10 @@
 #ifndef SCSI_PRINT_H_
 #define SCSI_PRINT_H_
 
+#include <string>
+
+#include "ocptelemetryprint.h"
+
 // Options for scsiPrintMain
 struct scsi_print_options
 {
@@ -63,6 +67,7 @@ struct scsi_print_options
   bool farm_log_suggest = false;  // If -x/-xall or -a/-all is run, suggests FARM log if supported
 
   bool ocp_telemetry = false;
+  ocp_telemetry_print_options ocp_telemetry_opts;
 };
 
 int scsiPrintMain(smartmon::scsi_device * device, const scsi_print_options & options);
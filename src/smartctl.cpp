@@ -31,6 +31,11 @@
 #include <sys/param.h>
 #endif
 
+#ifdef _WIN32
+#include <fcntl.h> // O_BINARY
+#include <io.h> // setmode()
+#endif
+
 #include <smartmon/atacmds.h>
 #include <smartmon/dev_interface.h>
 #include "ataprint.h"
@@ -38,6 +43,7 @@
 #include <smartmon/scsicmds.h>
 #include "scsiprint.h"
 #include "nvmeprint.h"
+#include "ocptelemetryprint.h"
 #include "smartctl.h"
 #include <smartmon/utility.h>
 #include <smartmon/version.h>
@@ -55,6 +61,15 @@ static json::print_options print_as_json_options;
 static bool print_as_json_output = false;
 static bool print_as_json_impl = false;
 static bool print_as_json_unimpl = false;
+static bool print_as_ndjson = false; // One line per device, see js_print()
+static bool js_printed = false; // Last document is already printed
+
+// Arguments for js_add_header()
+static int js_argc = 0;
+static char ** js_argv = nullptr;
+
+// Line counters of vjpout(), restarted for each document
+static int js_lineno = 0, js_outindex = 0, js_errindex = 0;
 
 static void printslogan()
 {
@@ -67,14 +82,9 @@ static void UsageSummary()
   return;
 }
 
-static void js_initialize(int argc, char **argv, bool verbose)
+// Add version info to a new JSON document
+static void js_add_header()
 {
-  if (jglb.is_enabled())
-    return;
-  jglb.enable();
-  if (verbose)
-    jglb.set_verbose();
-
   // Major.minor version of JSON format
   jglb["json_format_version"][0] = 1;
   jglb["json_format_version"][1] = 0;
@@ -110,8 +120,51 @@ static void js_initialize(int argc, char **argv, bool verbose)
 #endif
 
   jref["argv"][0] = "smartctl";
-  for (int i = 1; i < argc; i++)
-    jref["argv"][i] = argv[i];
+  for (int i = 1; i < js_argc; i++)
+    jref["argv"][i] = js_argv[i];
+}
+
+static void js_initialize(int argc, char **argv, bool verbose)
+{
+  if (jglb.is_enabled())
+    return;
+  jglb.enable();
+  if (verbose)
+    jglb.set_verbose();
+
+  js_argc = argc; js_argv = argv;
+  js_add_header();
+}
+
+// Discard the printed JSON document and start a new one
+static void js_new_document()
+{
+  jglb.clear();
+  js_lineno = js_outindex = js_errindex = 0;
+  js_printed = false;
+  js_add_header();
+}
+
+// Add exit status and print the JSON document
+static void js_print(int status)
+{
+  if (jglb.has_uint128_output())
+    jglb["smartctl"]["uint128_precision_bits"] = uint128_to_str_precision_bits();
+  if (jglb.get_stream_dropped()) {
+    // Internal error, a printer wrote an element of a streamed array twice
+    json::ref jref = jglb["smartctl"]["messages"][js_errindex++];
+    jref["string"] = strprintf("JSON output incomplete, %u value(s) dropped, first at '%s'",
+                               jglb.get_stream_dropped(), jglb.get_stream_dropped_path().c_str());
+    jref["severity"] = "error";
+  }
+  jglb["smartctl"]["exit_status"] = status;
+  jglb.print(stdout, print_as_json_options);
+  if (print_as_ndjson) {
+    // Compact JSON, one document per line
+    putchar('\n');
+    fflush(stdout);
+  }
+  js_printed = true;
 }
 
 static std::string getvalidarglist(int opt);
@@ -144,8 +197,8 @@ static void Usage()
   );
   pout(
 "================================== SMARTCTL RUN-TIME BEHAVIOR OPTIONS =====\n\n"
-"  -j, --json[=cgiosuvy]\n"
-"         Print output in JSON or YAML format\n\n"
+"  -j, --json[=bcginosuvy]\n"
+"         Print output in JSON, YAML or CBOR format\n\n"
 "  -q TYPE, --quietmode=TYPE                                           (ATA)\n"
 "         Set smartctl quiet mode to one of: errorsonly, silent, noserial\n\n"
 "  -d TYPE, --device=TYPE\n"
@@ -213,6 +266,8 @@ static void Usage()
 #endif
   pout(
          "]\n\n"
+"  --drivedb-compile=FILE                                               (ATA)\n"
+"        Write drive database FILE to binary file FILE.bin for faster reading\n\n"
 "============================================ DEVICE SELF-TEST OPTIONS =====\n\n"
 "  -t TEST, --test=TEST\n"
 "        Run test. TEST: offline, short, long, conveyance, force, vendor,N,\n"
@@ -228,7 +283,8 @@ static void Usage()
 }
 
 // Values for  --long only options, see parse_options()
-enum { opt_identify = 1000, opt_scan, opt_scan_open, opt_set, opt_smart };
+enum { opt_identify = 1000, opt_scan, opt_scan_open, opt_set, opt_smart,
+       opt_drivedb_compile };
 
 /* Returns a string containing a formatted list of the valid arguments
    to the option opt or empty on failure. Note 'v' case different */
@@ -245,6 +301,8 @@ static std::string getvalidarglist(int opt)
     return "warn, exit, ignore";
   case 'B':
     return "[+]<FILE_NAME>";
+  case opt_drivedb_compile:
+    return "<FILE_NAME>";
   case 'r':
     return "ioctl[,N], ataioctl[,N], scsiioctl[,N], nvmeioctl[,N]";
   case opt_smart:
@@ -259,7 +317,7 @@ static std::string getvalidarglist(int opt)
            "scterc[,N,M][,p|reset], devstat[,N], defects[,N], "
            "ssd, gplog,N[,RANGE], smartlog,N[,RANGE], "
            "nvmelog,N,SIZE, tapedevstat, zdevstat, envrep, farm, "
-           "ocptelemetry";
+           "ocptelemetry[,timeline][,series][,cache=DIR][,tail=FILE][,save=FILE|,load=FILE]";
   case 'P':
     return "use, ignore, show, showall";
   case 't':
@@ -281,7 +339,7 @@ static std::string getvalidarglist(int opt)
   case 's':
     return getvalidarglist(opt_smart)+", "+getvalidarglist(opt_set);
   case 'j':
-    return "c, g, i, o, s, u, v, y";
+    return "b, c, g, i, n, o, s, u, v, y";
   case opt_identify:
     return "n, wn, w, v, wv, wb";
   case 'v':
@@ -356,6 +414,7 @@ static int parse_options(int argc, char** argv, const char * & type,
     { "firmwarebug",     required_argument, 0, 'F' },
     { "nocheck",         required_argument, 0, 'n' },
     { "drivedb",         required_argument, 0, 'B' },
+    { "drivedb-compile", required_argument, 0, opt_drivedb_compile },
     { "format",          required_argument, 0, 'f' },
     { "get",             required_argument, 0, 'g' },
     { "json",            optional_argument, 0, 'j' },
@@ -376,6 +435,8 @@ static int parse_options(int argc, char** argv, const char * & type,
   int scan = 0; // set by --scan, --scan-open
   bool badarg = false, captive = false;
   int testcnt = 0; // number of self-tests requested
+  std::string ocp_capture_file; // set by '-l ocptelemetry,load=FILE'
+  std::string drivedb_compile_file; // set by --drivedb-compile=FILE
 
   int optchar;
   char *arg;
@@ -544,8 +605,51 @@ static int parse_options(int argc, char** argv, const char * & type,
         ataopts.gp_logdir = true; // GPL
       } else if (!strcmp(optarg, "genstats")) {
         scsiopts.general_stats_and_perf = true;
-      } else if (!strcmp(optarg,"ocptelemetry")) {
-        ataopts.ocp_telemetry = scsiopts.ocp_telemetry = true;
+      } else if (!strcmp(optarg,"ocptelemetry") || str_starts_with(optarg, "ocptelemetry,")) {
+        // ocptelemetry[,timeline][,series][,cache=DIR][,tail=FILE][,save=FILE|,load=FILE]
+        const char * p = optarg + 12;
+        std::string cache_dir, cursor_file, save_file, load_file;
+        bool timeline = false, stat_series = false;
+        while (*p == ',' && !badarg) {
+          p++;
+          if (str_starts_with(p, "timeline") && (!p[8] || p[8] == ',')) {
+            timeline = true;
+            p += 8;
+          } else if (str_starts_with(p, "series") && (!p[6] || p[6] == ',')) {
+            stat_series = true;
+            p += 6;
+          } else if (str_starts_with(p, "cache=") || str_starts_with(p, "tail=")) {
+            // DIR or FILE ends at the next comma
+            size_t len = (*p == 'c' ? 6 : 5);
+            size_t n = strcspn(p + len, ",");
+            (*p == 'c' ? cache_dir : cursor_file).assign(p + len, n);
+            p += len + n;
+            if (!n)
+              badarg = true;
+          } else if (str_starts_with(p, "save=") || str_starts_with(p, "load=")) {
+            // FILE is the remainder of the argument
+            (*p == 's' ? save_file : load_file) = p + 5;
+            p += strlen(p);
+            if (save_file.empty() && load_file.empty())
+              badarg = true;
+          } else
+            badarg = true;
+        }
+        if (*p)
+          badarg = true;
+        if (!badarg) {
+          if (!load_file.empty())
+            ocp_capture_file = load_file;
+          else
+            ataopts.ocp_telemetry = scsiopts.ocp_telemetry = true;
+          ocp_telemetry_print_options & opts = ataopts.ocp_telemetry_opts;
+          opts.capture_file = save_file;
+          opts.cache_dir = cache_dir;
+          opts.cursor_file = cursor_file;
+          opts.timeline = timeline;
+          opts.stat_series = stat_series;
+          scsiopts.ocp_telemetry_opts = opts;
+        }
       } else if (!strcmp(optarg,"sasphy")) {
         scsiopts.sasphy = true;
       } else if (!strcmp(optarg,"sasphy,reset")) {
@@ -965,6 +1069,9 @@ static int parse_options(int argc, char** argv, const char * & type,
           return FAILCMD;
       }
       break;
+    case opt_drivedb_compile: // --drivedb-compile=FILE
+      drivedb_compile_file = optarg;
+      break;
     case 'h':
       printing_is_off = false;
       printslogan();
@@ -1156,13 +1263,16 @@ static int parse_options(int argc, char** argv, const char * & type,
         print_as_json_options.format = 0;
         print_as_json_output = false;
         print_as_json_impl = print_as_json_unimpl = false;
+        print_as_ndjson = false;
         bool json_verbose = false;
         if (optarg_is_set) {
           for (int i = 0; optarg[i]; i++) {
             switch (optarg[i]) {
+              case 'b': print_as_json_options.format = 'b'; break;
               case 'c': print_as_json_options.pretty = false; break;
               case 'g': print_as_json_options.format = 'g'; break;
               case 'i': print_as_json_impl = true; break;
+              case 'n': print_as_ndjson = true; break;
               case 'o': print_as_json_output = true; break;
               case 's': print_as_json_options.sorted = true; break;
               case 'u': print_as_json_unimpl = true; break;
@@ -1172,6 +1282,11 @@ static int parse_options(int argc, char** argv, const char * & type,
             }
           }
         }
+        if (print_as_ndjson) {
+          if (print_as_json_options.format)
+            badarg = true; // JSON only
+          print_as_json_options.pretty = false;
+        }
         js_initialize(argc, argv, json_verbose);
       }
       break;
@@ -1234,6 +1349,29 @@ static int parse_options(int argc, char** argv, const char * & type,
     }
   }
 
+  // The tree is only needed to sort keys or to print YAML or flat format,
+  // otherwise large arrays are rendered to JSON text while they are written
+  if (print_as_json && !print_as_json_options.sorted && !print_as_json_options.format)
+    jglb.enable_streaming(print_as_json_options.pretty);
+  // CBOR keeps large integers as numbers, "KEY_s" and "KEY_le" are not needed
+  if (print_as_json && print_as_json_options.format == 'b') {
+    jglb.set_native_ints();
+#ifdef _WIN32
+    setmode(fileno(stdout), O_BINARY); // No \n -> \r\n conversion
+#endif
+  }
+
+  // Special handling of --drivedb-compile=FILE, no device is used
+  if (!drivedb_compile_file.empty()) {
+    if (argc - optind > 0) {
+      printslogan();
+      jerr("ERROR: smartctl --drivedb-compile=FILE does not take a device name.\n");
+      UsageSummary();
+      return FAILCMD;
+    }
+    return (compile_drive_database(drivedb_compile_file.c_str()) ? 0 : FAILCMD);
+  }
+
   // Special handling of --scan, --scanopen
   if (scan) {
     // Read or init drive database to allow USB ID check.
@@ -1243,6 +1381,18 @@ static int parse_options(int argc, char** argv, const char * & type,
     return 0;
   }
 
+  // Special handling of -l ocptelemetry,load=FILE, no device is used
+  if (!ocp_capture_file.empty()) {
+    printslogan();
+    if (argc - optind > 0) {
+      jerr("ERROR: smartctl -l ocptelemetry,load=FILE does not take a device name.\n");
+      UsageSummary();
+      return FAILCMD;
+    }
+    return (print_ocp_telemetry_capture(ocp_capture_file.c_str(), ataopts.ocp_telemetry_opts)
+            ? 0 : FAILSMART);
+  }
+
   // At this point we have processed all command-line options.  If the
   // print output is switchable, then start with the print output
   // turned off
@@ -1313,7 +1463,8 @@ static int parse_options(int argc, char** argv, const char * & type,
   }
   
   // Warn if the user has provided more than one device name
-  if (argc-optind>1){
+  // (allowed with --json=n)
+  if (argc-optind>1 && !print_as_ndjson){
     int i;
     jerr("ERROR: smartctl takes ONE device name as the final command-line argument.\n");
     pout("You have provided %d device names:\n",argc-optind);
@@ -1358,20 +1509,17 @@ static void vjpout(bool is_js_impl, const char * msg_severity,
       }
       *q++ = 0; // '\n' -> '\0'
 
-      static int lineno = 0;
-      lineno++;
+      js_lineno++;
       if (print_as_json_output) {
         // Collect full output in array
-        static int outindex = 0;
-        jglb["smartctl"]["output"][outindex++] = p;
+        jglb["smartctl"]["output"][js_outindex++] = p;
       }
       if (!*p)
         continue; // Skip empty line
 
       if (msg_severity) {
         // Collect non-empty messages in array
-        static int errindex = 0;
-        json::ref jref = jglb["smartctl"]["messages"][errindex++];
+        json::ref jref = jglb["smartctl"]["messages"][js_errindex++];
         jref["string"] = p;
         jref["severity"] = msg_severity;
       }
@@ -1379,7 +1527,7 @@ static void vjpout(bool is_js_impl, const char * msg_severity,
       if (   ( is_js_impl && print_as_json_impl  )
           || (!is_js_impl && print_as_json_unimpl)) {
         // Add (un)implemented non-empty lines to global object
-        jglb[strprintf("smartctl_%04d_%c", lineno,
+        jglb[strprintf("smartctl_%04d_%c", js_lineno,
                      (is_js_impl ? 'i' : 'u')).c_str()] = p;
       }
     }
@@ -1581,7 +1729,12 @@ void scan_devices(const smart_devtype_list & types, bool with_open, char ** argv
 
   for (unsigned i = 0; i < devlist.size(); i++) {
     smart_device_auto_ptr dev( devlist.release(i) );
-    json::ref jref = jglb["devices"][i];
+    if (print_as_ndjson && i > 0) {
+      // One document per device, the last one is printed by main()
+      js_print(0);
+      js_new_document();
+    }
+    json::ref jref = (print_as_ndjson ? jglb["device"] : jglb["devices"][i]);
 
     if (with_open) {
       printing_is_off = dont_print;
@@ -1613,33 +1766,13 @@ void scan_devices(const smart_devtype_list & types, bool with_open, char ** argv
   }
 }
 
-// Main program without exception handling
-static int main_worker(int argc, char **argv)
+// Open device NAME and run the ATA, SCSI or NVMe print functions
+static int main_device(const char * name, const char * type,
+                       const ata_print_options & ataopts,
+                       const scsi_print_options & scsiopts,
+                       const nvme_print_options & nvmeopts,
+                       bool print_type_only)
 {
-  // Throw if runtime environment does not match compile time test.
-  check_config();
-
-  // Register lib_vprintf() and on_checksum_error()
-  lib_global_hook::set(the_smartctl_hook);
-  lib_ata_hook::set(the_smartctl_hook);
-
-  // Initialize interface
-  smart_interface::init();
-  if (!smi())
-    return 1;
-
-  // Parse input arguments
-  const char * type = 0;
-  ata_print_options ataopts;
-  scsi_print_options scsiopts;
-  nvme_print_options nvmeopts;
-  bool print_type_only = false;
-  {
-    int status = parse_options(argc, argv, type, ataopts, scsiopts, nvmeopts, print_type_only);
-    if (status >= 0)
-      return status;
-  }
-
   // Store formatted current time for jout_startup_datetime()
   // Output as JSON regardless of '-i' option
   {
@@ -1648,8 +1781,6 @@ static int main_worker(int argc, char **argv)
     jglb["local_time"] += { {"time_t", now}, {"asctime", startup_datetime_buf} };
   }
 
-  const char * name = argv[argc-1];
-
   smart_device_auto_ptr dev;
   if (!strcmp(name,"-")) {
     // Parse "smartctl -r ataioctl,2 ..." output from stdin
@@ -1726,6 +1857,60 @@ static int main_worker(int argc, char **argv)
 }
 
 
+// Main program without exception handling
+static int main_worker(int argc, char **argv)
+{
+  // Throw if runtime environment does not match compile time test.
+  check_config();
+
+  // Register lib_vprintf() and on_checksum_error()
+  lib_global_hook::set(the_smartctl_hook);
+  lib_ata_hook::set(the_smartctl_hook);
+
+  // Initialize interface
+  smart_interface::init();
+  if (!smi())
+    return 1;
+
+  // Parse input arguments
+  const char * type = 0;
+  ata_print_options ataopts;
+  scsi_print_options scsiopts;
+  nvme_print_options nvmeopts;
+  bool print_type_only = false;
+  {
+    int status = parse_options(argc, argv, type, ataopts, scsiopts, nvmeopts, print_type_only);
+    if (status >= 0)
+      return status;
+  }
+
+  if (!print_as_ndjson)
+    return main_device(argv[argc-1], type, ataopts, scsiopts, nvmeopts, print_type_only);
+
+  // --json=n: Print one document per device as soon as it is complete
+  int status = 0;
+  bool printing_was_off = printing_is_off;
+  unsigned char permissive = failuretest_permissive;
+  for (int i = optind; i < argc; i++) {
+    if (i > optind)
+      js_new_document();
+    printing_is_off = printing_was_off;
+    failuretest_permissive = permissive;
+    int devstatus;
+    try {
+      devstatus = main_device(argv[i], type, ataopts, scsiopts, nvmeopts, print_type_only);
+    }
+    catch (int ex) {
+      // Exit status from checksumwarning() and failuretest()
+      devstatus = ex;
+    }
+    js_print(devstatus);
+    status |= devstatus;
+  }
+  return status;
+}
+
+
 // Main program
 int main(int argc, char **argv)
 {
@@ -1742,10 +1927,8 @@ int main(int argc, char **argv)
       status = ex;
     }
     // Print JSON if enabled
-    if (jglb.has_uint128_output())
-      jglb["smartctl"]["uint128_precision_bits"] = uint128_to_str_precision_bits();
-    jglb["smartctl"]["exit_status"] = status;
-    jglb.print(stdout, print_as_json_options);
+    if (!js_printed)
+      js_print(status);
   }
   catch (const std::bad_alloc & /*ex*/) {
     // Memory allocation failed (also thrown by std::operator new)
@@ -71,6 +71,7 @@ typedef int pid_t;
 #include <smartmon/knowndrives.h>
 #include <smartmon/scsicmds.h>
 #include <smartmon/nvmecmds.h>
+#include <smartmon/ocptelemetry.h>
 #include <smartmon/utility.h>
 #include <smartmon/sg_unaligned.h>
 
@@ -392,6 +393,8 @@ struct dev_config
   bool offlinests_ns{};                   // Disable auto standby if in progress
   bool selfteststs{};                     // Monitor changes in self-test execution status
   bool selfteststs_ns{};                  // Disable auto standby if in progress
+  bool ocpevents{};                       // Monitor new events in OCP telemetry event FIFOs
+  bool ocpstats{};                        // Monitor increase of OCP telemetry counter statistics
   bool permissive{};                      // Ignore failed SMART commands
   char autosave{};                        // 1=disable, 2=enable Autosave Attributes
   char autoofflinetest{};                 // 1=disable, 2=enable Auto Offline Test
@@ -431,6 +434,7 @@ struct dev_config
   unsigned char offl_pending_id{};        // ID of offline uncorrectable sector count, 0 if none
   bool curr_pending_incr{}, offl_pending_incr{}; // True if current/offline pending values increase
   bool curr_pending_set{},  offl_pending_set{};  // True if '-C', '-U' set in smartd.conf
+  unsigned ocp_nsectors_0x24{};           // Size of GP log 0x24 for '-l ocpevents|ocpstats'
 
   attribute_flags monitor_attr_flags;     // MONITOR_* flags for each attribute
 
@@ -441,7 +445,7 @@ struct dev_config
 };
 
 // Number of allowed mail message types
-static const int SMARTD_NMAIL = 13;
+static const int SMARTD_NMAIL = 14;
 // Type for '-M test' mails (state not persistent)
 static const int MAILTYPE_TEST = 0;
 // TODO: Add const or enum for all mail types.
@@ -501,6 +505,11 @@ struct persistent_dev_state
   // NVMe SMART/Health information: only the fields avail_spare,
   // percent_used and media_errors are persistent.
   nvme_smart_log nvme_smartval{};
+
+  // ATA and SCSI
+  ocp_event_cursor ocp_events[2];         // Last read event of OCP event FIFO 1 and 2
+  std::map<uint16_t, uint64_t> ocp_stats; // Last values of OCP counter statistics by ID
+  time_t ocp_stats_time{};                // Time of these values
 };
 
 /// Non-persistent state data for a device.
@@ -528,6 +537,8 @@ struct temp_dev_state
 
   int attrlog_valid{};                    // nonzero if data is valid for protocol specific
                                           // attribute log: 1=ATA, 2=SCSI, 3=NVMe
+  std::map<uint16_t, double> ocp_stat_rates; // Increase per hour of OCP statistics since
+                                          // last check, for attribute log
 
   // SCSI ONLY
   // TODO: change to bool
@@ -647,11 +658,20 @@ static bool parse_dev_state_line(const char * line, persistent_dev_state & state
      "|(nvme-available-spare)" // (25)
      "|(nvme-percentage-used)" // (26)
      "|(nvme-media-errors)" // (27)
+     "|(ocp-event-fifo\\.([12])\\." // (28 (29)
+       "((end)" // (30 (31)
+       "|(tail-dwords)" // (32)
+       "|(tail-hash)" // (33)
+       "|(timestamp)" // (34)
+       ")" // 30)
+      ")" // 28)
+     "|(ocp-statistic\\.([0-9]+)\\.val)" // (35 (36)
+     "|(ocp-statistics-time)" // (37)
      ")" // 1)
-     " *= *([0-9]+)[ \n]*$" // (28)
+     " *= *([0-9]+)[ \n]*$" // (38)
   );
 
-  constexpr int nmatch = 1+28;
+  constexpr int nmatch = 1+38;
   regular_expression::match_range match[nmatch];
   if (!regex.execute(line, match))
     return false;
@@ -717,6 +737,30 @@ static bool parse_dev_state_line(const char * line, persistent_dev_state & state
     state.nvme_smartval.percent_used = val;
   else if (match[++m].rm_so >= 0)
     state.nvme_smartval.media_errors = uint64_to_uile128(val);
+  else if (match[++m].rm_so >= 0) {
+    ocp_event_cursor & c = state.ocp_events[atoi(line+match[m+1].rm_so) - 1];
+    if (match[m+=3].rm_so >= 0)
+      c.end_dword = val;
+    else if (match[++m].rm_so >= 0) {
+      if (val > OCP_EVENT_CURSOR_TAIL_DWORDS)
+        return false;
+      c.tail_dwords = (uint32_t)val;
+    }
+    else if (match[++m].rm_so >= 0)
+      c.tail_hash = val;
+    else if (match[++m].rm_so >= 0)
+      c.last_timestamp = val;
+    else
+      return false;
+  }
+  else if (match[m+=7].rm_so >= 0) {
+    int id = atoi(line+match[m+1].rm_so);
+    if (!(0 <= id && id <= 0xffff))
+      return false;
+    state.ocp_stats[(uint16_t)id] = val;
+  }
+  else if (match[m+=2].rm_so >= 0)
+    state.ocp_stats_time = (time_t)val;
   else
     return false;
   return true;
@@ -828,6 +872,22 @@ static bool write_dev_state(const char * path, const persistent_dev_state & stat
   write_dev_state_line(f, "nvme-media-errors",
     uile128_clamp_to_uint64(state.nvme_smartval.media_errors));
 
+  // ATA and SCSI
+  for (int i = 0; i < 2; i++) {
+    const ocp_event_cursor & c = state.ocp_events[i];
+    if (!c.valid())
+      continue;
+    write_dev_state_line(f, "ocp-event-fifo", i + 1, "end", c.end_dword);
+    write_dev_state_line(f, "ocp-event-fifo", i + 1, "tail-dwords", c.tail_dwords);
+    write_dev_state_line(f, "ocp-event-fifo", i + 1, "tail-hash", c.tail_hash);
+    write_dev_state_line(f, "ocp-event-fifo", i + 1, "timestamp", c.last_timestamp);
+  }
+  // Zero values are also needed to compute the next increase
+  for (const auto & st : state.ocp_stats)
+    fprintf(f, "ocp-statistic.%u.val = %" PRIu64 "\n", st.first, st.second);
+  if (!state.ocp_stats.empty())
+    write_dev_state_line(f, "ocp-statistics-time", state.ocp_stats_time);
+
   return true;
 }
 
@@ -908,6 +968,16 @@ static void write_nvme_attrlog(FILE * f, const dev_state & state)
   );
 }
 
+static void write_ocp_attrlog(FILE * f, const dev_state & state)
+{
+  for (const auto & st : state.ocp_stats) {
+    fprintf(f, "\tocp-statistic-0x%04x;%" PRIu64 ";", st.first, st.second);
+    auto rate = state.ocp_stat_rates.find(st.first);
+    if (rate != state.ocp_stat_rates.end())
+      fprintf(f, "\tocp-statistic-0x%04x-per-hour;%.3f;", st.first, rate->second);
+  }
+}
+
 // Write to the attrlog file
 static bool write_dev_attrlog(const char * path, const dev_state & state)
 {
@@ -928,6 +998,7 @@ static bool write_dev_attrlog(const char * path, const dev_state & state)
     case 2: write_scsi_attrlog(f, state); break;
     case 3: write_nvme_attrlog(f, state); break;
   }
+  write_ocp_attrlog(f, state);
 
   fprintf(f, "\n");
   return true;
@@ -1119,7 +1190,8 @@ static void MailWarning(const dev_config & cfg, dev_state & state, int which, co
     "FailedOpenDevice",           // 9
     "CurrentPendingSector",       // 10
     "OfflineUncorrectableSector", // 11
-    "Temperature"                 // 12
+    "Temperature",                // 12
+    "OcpStatSaturated"            // 13
   };
   SMARTMON_STATIC_ASSERT(sizeof(whichfail) == SMARTD_NMAIL * sizeof(whichfail[0]));
   
@@ -1600,7 +1672,8 @@ static void Directives()
            "  -H MASK Monitor specific NVMe Critical Warning bits\n"
            "  -s REG  Do Self-Test at time(s) given by regular expression REG\n"
            "  -l TYPE Monitor SMART log or self-test status:\n"
-           "          error, selftest, xerror, offlinests[,ns], selfteststs[,ns]\n"
+           "          error, selftest, xerror, offlinests[,ns], selfteststs[,ns],\n"
+           "          ocpevents, ocpstats\n"
            "  -l scterc,R,W  Set SCT Error Recovery Control\n"
            "  -e      Change device setting: aam,[N|off], apm,[N|off], dsn,[on|off],\n"
            "          lookahead,[on|off], security-freeze, standby,[N|off], wcache,[on|off]\n"
@@ -2273,7 +2346,7 @@ static int ATADeviceScan(dev_config & cfg, dev_state & state, ata_device * atade
         smart_logdir_ok = true;
   }
 
-  if (cfg.xerrorlog && !cfg.firmwarebugs.is_set(BUG_NOLOGDIR)) {
+  if ((cfg.xerrorlog || cfg.ocpevents || cfg.ocpstats) && !cfg.firmwarebugs.is_set(BUG_NOLOGDIR)) {
     if (!ataReadLogDirectory(atadev, &gp_logdir, true))
       gp_logdir_ok = true;
   }
@@ -2339,6 +2412,19 @@ static int ATADeviceScan(dev_config & cfg, dev_state & state, ata_device * atade
       state.ataerrorcount = errcnt2;
   }
 
+  // capability check: OCP telemetry event FIFOs and statistics
+  if (cfg.ocpevents || cfg.ocpstats) {
+    unsigned nsectors = (gp_logdir_ok ? gp_logdir.entry[0x24-1].numsectors : 0);
+    if (nsectors < 2) {
+      PrintOut(LOG_INFO, "Device: %s, no OCP Telemetry in GP Log 0x24, ignoring -l %s\n", name,
+               (cfg.ocpevents && cfg.ocpstats ? "ocpevents, -l ocpstats" :
+                cfg.ocpevents ? "ocpevents" : "ocpstats"));
+      cfg.ocpevents = cfg.ocpstats = false;
+    }
+    else
+      cfg.ocp_nsectors_0x24 = nsectors;
+  }
+
   // capability check: self-test and offline data collection status
   if (cfg.offlinests || cfg.selfteststs) {
     if (!(cfg.permissive || (smart_val_ok && state.smartval.offline_data_collection_capability))) {
@@ -2424,7 +2510,7 @@ static int ATADeviceScan(dev_config & cfg, dev_state & state, ata_device * atade
 
   // If no tests available or selected, return
   if (!(   cfg.smartcheck  || cfg.selftest
-        || cfg.errorlog    || cfg.xerrorlog
+        || cfg.errorlog    || cfg.xerrorlog    || cfg.ocpevents || cfg.ocpstats
         || cfg.offlinests  || cfg.selfteststs
         || cfg.usagefailed || cfg.prefail  || cfg.usage
         || cfg.tempdiff    || cfg.tempinfo || cfg.tempcrit)) {
@@ -2676,6 +2762,17 @@ static int SCSIDeviceScan(dev_config & cfg, dev_state & state, scsi_device * scs
       state.selfloghour  = (retval >> 8) & 0xffff;
     }
   }
+
+  // capability check: OCP telemetry event FIFOs and statistics
+  if (cfg.ocpevents || cfg.ocpstats) {
+    ocp_scsi_log_reader reader(scsidev);
+    if (!(reader.read_directory() && reader.get_num_sectors(0x24) >= 2)) {
+      PrintOut(LOG_INFO, "Device: %s, no OCP Telemetry error history buffer, ignoring -l %s\n",
+               device, (cfg.ocpevents && cfg.ocpstats ? "ocpevents, -l ocpstats" :
+                        cfg.ocpevents ? "ocpevents" : "ocpstats"));
+      cfg.ocpevents = cfg.ocpstats = false;
+    }
+  }
   
   // disable autosave (set GLTSD bit)
   if (cfg.autosave==1){
@@ -3055,6 +3152,135 @@ static void report_self_test_log_changes(const dev_config & cfg, dev_state & sta
   return;
 }
 
+// Report new events in the OCP telemetry event FIFOs.  Only the events
+// following the positions saved in the state are read.
+static void check_ocp_events(const dev_config & cfg, dev_state & state,
+                             ocp_log_reader & reader, unsigned nsectors_0x24)
+{
+  const char * name = cfg.name.c_str();
+
+  ata_device_internal_status internal_status;
+  ocp_telemetry_data_header data_header;
+  if (!read_ata_ocp_telemetry_data_header(reader, nsectors_0x24, &internal_status, &data_header)) {
+    PrintOut(LOG_INFO, "Device: %s, Read OCP Telemetry Data Header failed\n", name);
+    return;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    ocp_event_cursor cursor = state.ocp_events[i];
+    std::vector<uint8_t> events;
+    bool lost = false;
+    if (!read_ata_ocp_telemetry_new_events(reader, &data_header, i + 1, &cursor, events, &lost)) {
+      PrintOut(LOG_INFO, "Device: %s, Read OCP Telemetry Event FIFO %d failed\n", name, i + 1);
+      return;
+    }
+
+    ocp_event_desc_range descs(events.data(), events.size() >> 2);
+    unsigned num_events = (unsigned)std::distance(descs.begin(), descs.end());
+
+    if (lost)
+      PrintOut(LOG_INFO, "Device: %s, OCP Telemetry Event FIFO %d: last read event not found, "
+               "events may have been lost\n", name, i + 1);
+    if (num_events)
+      PrintOut(LOG_INFO, "Device: %s, OCP Telemetry Event FIFO %d: %u new event%s\n",
+               name, i + 1, num_events, (num_events == 1 ? "" : "s"));
+
+    const ocp_event_cursor & old = state.ocp_events[i];
+    if (!(   cursor.end_dword == old.end_dword && cursor.tail_dwords == old.tail_dwords
+          && cursor.tail_hash == old.tail_hash && cursor.last_timestamp == old.last_timestamp)) {
+      state.ocp_events[i] = cursor;
+      state.must_write = true;
+    }
+  }
+}
+
+// Format OCP statistic ID and name, if known.
+static std::string ocp_stat_name(uint16_t id)
+{
+  const char * desc = ocp_builtin_stat_id_to_str(id);
+  return (desc ? strprintf("0x%04x (%s)", id, desc) : strprintf("0x%04x", id));
+}
+
+// Report the increase of the OCP telemetry counter statistics since the
+// last check.  The behavior type of each statistic selects how resets and
+// saturation are handled.
+static void check_ocp_stats(const dev_config & cfg, dev_state & state,
+                            ocp_log_reader & reader, unsigned nsectors_0x24)
+{
+  const char * name = cfg.name.c_str();
+
+  ocp_telemetry_session session;
+  if (!session.read_statistics(reader, nsectors_0x24)) {
+    PrintOut(LOG_INFO, "Device: %s, Read OCP Telemetry Statistics failed\n", name);
+    return;
+  }
+
+  time_t now = time(nullptr);
+  double hours = (state.ocp_stats_time && now > state.ocp_stats_time
+                  ? (now - state.ocp_stats_time) / 3600.0 : 0);
+  std::map<uint16_t, uint64_t> new_stats;
+  state.ocp_stat_rates.clear();
+
+  for (const ocp_telemetry_session::area & area : session.statistic_areas) {
+    if (!area.data)
+      continue;
+    for (const ocp_stat_desc_view & sv : ocp_stat_desc_range(area.data, area.dwords)) {
+      uint64_t val;
+      if (!(   ocp_stat_is_counter(sv.behavior_type(), sv.unit())
+            && sv.data_type() == OCP_DATA_TYPE_UINT && sv.get_uint(&val)))
+        continue;
+      uint16_t id = sv.id();
+      if (new_stats.find(id) != new_stats.end())
+        continue; // Use first descriptor only
+      new_stats[id] = val;
+
+      auto old = state.ocp_stats.find(id);
+      if (old == state.ocp_stats.end())
+        continue; // First sample
+
+      uint64_t delta = 0;
+      switch (ocp_stat_delta(sv.behavior_type(), sv.data_size(), old->second, val, &delta)) {
+        case OCP_DELTA_OK:
+          break;
+        case OCP_DELTA_RESET:
+          PrintOut(LOG_INFO, "Device: %s, OCP statistic %s was reset, increased by %" PRIu64
+                   " since reset\n", name, ocp_stat_name(id).c_str(), delta);
+          continue;
+        case OCP_DELTA_SATURATED:
+          PrintOut(LOG_CRIT, "Device: %s, OCP statistic %s saturated at %" PRIu64
+                   ", further increases are unknown\n", name, ocp_stat_name(id).c_str(), val);
+          MailWarning(cfg, state, 13, "Device: %s, OCP statistic %s saturated at %" PRIu64,
+                      name, ocp_stat_name(id).c_str(), val);
+          continue;
+        case OCP_DELTA_UNKNOWN:
+          if (val < old->second)
+            PrintOut(LOG_INFO, "Device: %s, OCP statistic %s decreased from %" PRIu64
+                     " to %" PRIu64 "\n", name, ocp_stat_name(id).c_str(), old->second, val);
+          continue;
+        default:
+          continue;
+      }
+
+      if (hours > 0)
+        state.ocp_stat_rates[id] = delta / hours;
+      if (!delta)
+        continue;
+      if (hours > 0)
+        PrintOut(LOG_INFO, "Device: %s, OCP statistic %s increased by %" PRIu64 " to %" PRIu64
+                 " (%.2f/hour)\n", name, ocp_stat_name(id).c_str(), delta, val, delta / hours);
+      else
+        PrintOut(LOG_INFO, "Device: %s, OCP statistic %s increased by %" PRIu64 " to %" PRIu64 "\n",
+                 name, ocp_stat_name(id).c_str(), delta, val);
+    }
+  }
+
+  if (new_stats != state.ocp_stats) {
+    state.ocp_stats.swap(new_stats);
+    state.must_write = true;
+  }
+  state.ocp_stats_time = now;
+}
+
 // Test types, ordered by priority.
 static const char test_type_chars[] = "LncrSCO";
 static const unsigned num_test_types = sizeof(test_type_chars)-1;
@@ -3859,6 +4085,15 @@ static int ATACheckDevice(const dev_config & cfg, dev_state & state, ata_device
       state.ataerrorcount=newc;
   }
 
+  // report new OCP telemetry events and increased statistics
+  if (cfg.ocpevents || cfg.ocpstats) {
+    ocp_ata_log_reader reader(atadev);
+    if (cfg.ocpevents)
+      check_ocp_events(cfg, state, reader, cfg.ocp_nsectors_0x24);
+    if (cfg.ocpstats)
+      check_ocp_stats(cfg, state, reader, cfg.ocp_nsectors_0x24);
+  }
+
   // if the user has asked, and device is capable (or we're not yet
   // sure) check whether a self test should be done now.
   if (allow_selftests && !cfg.test_regex.empty()) {
@@ -3916,6 +4151,19 @@ static int SCSICheckDevice(const dev_config & cfg, dev_state & state, scsi_devic
     report_self_test_log_changes(cfg, state, (retval >= 0 ? (retval & 0xff) : -1), retval >> 8);
   }
 
+  // report new OCP telemetry events and increased statistics
+  if (cfg.ocpevents || cfg.ocpstats) {
+    ocp_scsi_log_reader reader(scsidev);
+    if (!reader.read_directory())
+      PrintOut(LOG_INFO, "Device: %s, Read OCP Telemetry error history directory failed\n", name);
+    else {
+      if (cfg.ocpevents)
+        check_ocp_events(cfg, state, reader, reader.get_num_sectors(0x24));
+      if (cfg.ocpstats)
+        check_ocp_stats(cfg, state, reader, reader.get_num_sectors(0x24));
+    }
+  }
+
   if (allow_selftests && !cfg.test_regex.empty()) {
     char testtype = next_scheduled_test(cfg, state);
     if (testtype)
@@ -4800,6 +5048,12 @@ static int ParseToken(char * & token, dev_config & cfg, smart_devtype_list & sca
     } else if (!strcmp(arg, "selfteststs,ns")) {
       // track changes in self-test execution status, disable auto standby
       cfg.selfteststs = cfg.selfteststs_ns = true;
+    } else if (!strcmp(arg, "ocpevents")) {
+      // report new events in OCP telemetry event FIFOs
+      cfg.ocpevents = true;
+    } else if (!strcmp(arg, "ocpstats")) {
+      // report increase of OCP telemetry counter statistics
+      cfg.ocpstats = true;
     } else if (!strncmp(arg, "scterc,", sizeof("scterc,")-1)) {
         // set SCT Error Recovery Control
         unsigned rt = ~0, wt = ~0; int nc = -1;
@@ -5220,7 +5474,7 @@ static int ParseConfigLine(dev_config_vector & conf_entries, dev_config & defaul
 
   // If NO monitoring directives are set, then set all of them.
   if (!(   cfg.smartcheck  || cfg.selftest
-        || cfg.errorlog    || cfg.xerrorlog
+        || cfg.errorlog    || cfg.xerrorlog    || cfg.ocpevents || cfg.ocpstats
         || cfg.offlinests  || cfg.selfteststs
         || cfg.usagefailed || cfg.prefail  || cfg.usage
         || cfg.tempdiff    || cfg.tempinfo || cfg.tempcrit)) {